@@ -0,0 +1,213 @@
+/*
+    contention.c -- Reader scaling benchmark for /dev/reversi.
+
+    One writer thread keeps playing games on a shared descriptor while a
+    growing number of reader threads fetch the board from it as fast as
+    they can. Board reads go through the published snapshot and never
+    take the game lock, so reads per second should grow with the number
+    of readers instead of flattening out behind the writer.
+
+    Usage: contention [-s seconds] [-t max threads] [-m]
+        -m  read the mmap page instead of using REVERSI_IOC_GET_BOARD
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
+#include "reversi_ioctl.h"
+
+static int fd;
+static const struct reversi_shared *page;
+static volatile int stop;
+static volatile int go;
+static unsigned long long writerMoves;
+
+struct reader {
+    pthread_t thread;
+    unsigned long long reads;
+    char pad[64];
+};
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *writer_main(void *arg) {
+    struct reversi_new_game ng = { REVERSI_X, 1 };
+    struct reversi_moves m;
+    struct reversi_move mv;
+    struct reversi_cpu_move cm;
+    struct reversi_pass p;
+    int status;
+
+    (void)arg;
+
+    /* Plays the first legal move against a depth 1 CPU, over and over */
+    while(!stop) {
+        if(ioctl(fd, REVERSI_IOC_NEW_GAME, &ng) < 0) {
+            perror("REVERSI_IOC_NEW_GAME");
+            exit(EXIT_FAILURE);
+        }
+
+        for(status = REVERSI_OK; status == REVERSI_OK && !stop;) {
+            ioctl(fd, REVERSI_IOC_GET_MOVES, &m);
+
+            if(m.moves) {
+                mv.col = __builtin_ctzll(m.moves) % 8;
+                mv.row = __builtin_ctzll(m.moves) / 8;
+                ioctl(fd, REVERSI_IOC_MOVE, &mv);
+                status = mv.status;
+            }
+            else {
+                ioctl(fd, REVERSI_IOC_PASS, &p);
+                status = p.status;
+            }
+
+            if(status == REVERSI_OK) {
+                ioctl(fd, REVERSI_IOC_CPU_MOVE, &cm);
+                status = cm.status;
+            }
+
+            writerMoves += 2;
+        }
+    }
+
+    return NULL;
+}
+
+static void *reader_main(void *arg) {
+    struct reader *r = (struct reader *)arg;
+    struct reversi_board b;
+    struct reversi_shared s;
+    unsigned long long n = 0;
+
+    while(!go)
+        ;
+
+    while(!stop) {
+        if(page) {
+            reversi_shared_read(page, &s);
+        }
+        else if(ioctl(fd, REVERSI_IOC_GET_BOARD, &b) < 0) {
+            perror("REVERSI_IOC_GET_BOARD");
+            exit(EXIT_FAILURE);
+        }
+
+        ++n;
+    }
+
+    r->reads = n;
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    struct reader *readers;
+    pthread_t writer;
+    double seconds = 2.0, start, elapsed, base = 0.0, rate;
+    int maxThreads = (int)sysconf(_SC_NPROCESSORS_ONLN), threads, i, opt;
+    unsigned long long total, moves;
+
+    while((opt = getopt(argc, argv, "s:t:m")) != -1) {
+        switch(opt) {
+            case 's':
+                seconds = atof(optarg);
+                break;
+
+            case 't':
+                maxThreads = atoi(optarg);
+                break;
+
+            case 'm':
+                page = (const struct reversi_shared *)1;
+                break;
+
+            default:
+                fprintf(stderr, "Usage: %s [-s seconds] [-t max threads] "
+                        "[-m]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if((fd = open("/dev/reversi", O_RDWR)) < 0) {
+        perror("Cannot open /dev/reversi");
+        return EXIT_FAILURE;
+    }
+
+    if(page) {
+        page = mmap(NULL, sizeof(*page), PROT_READ, MAP_SHARED, fd, 0);
+
+        if(page == MAP_FAILED) {
+            perror("Cannot map the board page");
+            return EXIT_FAILURE;
+        }
+    }
+
+    if(maxThreads < 1)
+        maxThreads = 1;
+
+    readers = calloc(maxThreads, sizeof(*readers));
+    pthread_create(&writer, NULL, writer_main, NULL);
+
+    printf("%-8s %14s %14s %8s %12s\n", "readers", "reads/s", "per reader",
+           "scaling", "writer mv/s");
+
+    /* 1, 2, 4, ... readers, finishing with one per CPU */
+    for(threads = 1;; threads *= 2) {
+        if(threads > maxThreads)
+            threads = maxThreads;
+
+        go = 0;
+        stop = 0;
+
+        for(i = 0; i < threads; ++i) {
+            pthread_create(&readers[i].thread, NULL, reader_main, &readers[i]);
+        }
+
+        moves = writerMoves;
+        start = now();
+        go = 1;
+        usleep((useconds_t)(seconds * 1e6));
+        stop = 1;
+
+        total = 0;
+        for(i = 0; i < threads; ++i) {
+            pthread_join(readers[i].thread, NULL);
+            total += readers[i].reads;
+        }
+
+        elapsed = now() - start;
+        rate = total / elapsed;
+
+        if(threads == 1)
+            base = rate;
+
+        printf("%-8d %14.0f %14.0f %7.2fx %12.0f\n", threads, rate,
+               rate / threads, rate / base,
+               (writerMoves - moves) / elapsed);
+
+        /* Restarts the writer for the next round */
+        pthread_join(writer, NULL);
+        stop = 0;
+        pthread_create(&writer, NULL, writer_main, NULL);
+
+        if(threads == maxThreads)
+            break;
+    }
+
+    stop = 1;
+    pthread_join(writer, NULL);
+    free(readers);
+    close(fd);
+    return EXIT_SUCCESS;
+}
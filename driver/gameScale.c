@@ -0,0 +1,202 @@
+/*
+    gameScale.c -- Game table scaling benchmark for /dev/reversi.
+
+    Creates a large number of games with REVERSI_IOC_CREATE_GAME, spread
+    over a few threads, then goes back over every one of them to attach,
+    start a game and play the first move. Prints creates/sec and
+    moves/sec plus how much kernel memory the games take, from the slab
+    counters in /proc/meminfo and the module's own debugfs numbers.
+
+    The module's caps have to allow that many games, for 10^6 load it with
+    e.g. max_games=0 max_bytes=0, otherwise the oldest games are evicted
+    as new ones come in. Games stay in the table after this exits until
+    the module's idle_timeout evicts them.
+
+    Usage: gameScale [-n games] [-t threads]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/ioctl.h>
+
+#include "reversi_ioctl.h"
+
+struct worker {
+    pthread_t thread;
+    int fd;
+    __u64 *ids;
+    long count;
+    long done;
+};
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Slab memory the kernel can't reclaim, in kB, -1 if it can't be read */
+static long slab_kb(void) {
+    char line[256];
+    long kb = -1;
+    FILE *f = fopen("/proc/meminfo", "r");
+
+    if(!f)
+        return -1;
+
+    while(fgets(line, sizeof(line), f)) {
+        if(sscanf(line, "SUnreclaim: %ld kB", &kb) == 1)
+            break;
+    }
+
+    fclose(f);
+    return kb;
+}
+
+static void *create_main(void *arg) {
+    struct worker *w = (struct worker *)arg;
+    struct reversi_game_id gid;
+
+    for(w->done = 0; w->done < w->count; ++w->done) {
+        if(ioctl(w->fd, REVERSI_IOC_CREATE_GAME, &gid) < 0) {
+            perror("REVERSI_IOC_CREATE_GAME");
+            break;
+        }
+
+        w->ids[w->done] = gid.id;
+    }
+
+    return NULL;
+}
+
+static void *move_main(void *arg) {
+    struct worker *w = (struct worker *)arg;
+    struct reversi_new_game ng = { REVERSI_X, 1 };
+    struct reversi_move mv = { 3, 2, 0, 0 };
+    struct reversi_game_id gid;
+    long i;
+
+    /* The first of X's opening moves, on every game this thread made */
+    for(i = 0; i < w->count; ++i) {
+        gid.id = w->ids[i];
+
+        if(ioctl(w->fd, REVERSI_IOC_ATTACH_GAME, &gid) < 0 ||
+           ioctl(w->fd, REVERSI_IOC_NEW_GAME, &ng) < 0 ||
+           ioctl(w->fd, REVERSI_IOC_MOVE, &mv) < 0 ||
+           mv.status != REVERSI_OK) {
+            fprintf(stderr, "game %llu: %s\n", (unsigned long long)gid.id,
+                    errno == ENOENT ? "evicted, are the caps high enough?"
+                                    : strerror(errno));
+            break;
+        }
+    }
+
+    w->done = i;
+    return NULL;
+}
+
+static double run(struct worker *workers, int threads,
+                  void *(*fn)(void *), long *done) {
+    double start = now();
+    int t;
+
+    for(t = 0; t < threads; ++t)
+        pthread_create(&workers[t].thread, NULL, fn, &workers[t]);
+
+    *done = 0;
+
+    for(t = 0; t < threads; ++t) {
+        pthread_join(workers[t].thread, NULL);
+        *done += workers[t].done;
+    }
+
+    return now() - start;
+}
+
+int main(int argc, char *argv[]) {
+    struct worker *workers;
+    __u64 *ids;
+    long games = 1000000, per, done;
+    long slabBefore, slabAfter;
+    int threads = 4, t, opt;
+    double secs;
+    char line[128];
+    FILE *f;
+
+    while((opt = getopt(argc, argv, "n:t:")) != -1) {
+        switch(opt) {
+            case 'n':
+                games = atol(optarg);
+                break;
+
+            case 't':
+                threads = atoi(optarg);
+                break;
+
+            default:
+                fprintf(stderr, "Usage: %s [-n games] [-t threads]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if(games < 1 || threads < 1) {
+        fprintf(stderr, "Need at least one game and one thread\n");
+        return EXIT_FAILURE;
+    }
+
+    ids = calloc(games, sizeof(*ids));
+    workers = calloc(threads, sizeof(*workers));
+    per = (games + threads - 1) / threads;
+
+    for(t = 0; t < threads; ++t) {
+        if((workers[t].fd = open("/dev/reversi", O_RDWR)) < 0) {
+            perror("Cannot open /dev/reversi");
+            return EXIT_FAILURE;
+        }
+
+        workers[t].ids = ids + t * per;
+        workers[t].count = t * per >= games ? 0 :
+                           (games - t * per < per ? games - t * per : per);
+    }
+
+    slabBefore = slab_kb();
+    secs = run(workers, threads, create_main, &done);
+    slabAfter = slab_kb();
+
+    printf("created %ld games in %.2f s, %.0f creates/s\n", done, secs,
+           done / secs);
+
+    if(slabBefore >= 0 && slabAfter >= 0 && done > 0)
+        printf("unreclaimable slab grew %ld kB, %.0f bytes/game\n",
+               slabAfter - slabBefore,
+               (slabAfter - slabBefore) * 1024.0 / done);
+
+    /* Root only, and debugfs may not be mounted */
+    if((f = fopen("/sys/kernel/debug/reversi/games", "r"))) {
+        while(fgets(line, sizeof(line), f))
+            printf("  %s", line);
+
+        fclose(f);
+    }
+
+    for(t = 0; t < threads; ++t)
+        workers[t].count = workers[t].done;
+
+    secs = run(workers, threads, move_main, &done);
+    printf("played a move in %ld games in %.2f s, %.0f moves/s "
+           "(%.0f ioctls/s)\n", done, secs, done / secs, 3 * done / secs);
+
+    for(t = 0; t < threads; ++t)
+        close(workers[t].fd);
+
+    free(workers);
+    free(ids);
+    return EXIT_SUCCESS;
+}
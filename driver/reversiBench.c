@@ -0,0 +1,380 @@
+/*
+    reversiBench.c -- Load generator and latency benchmark for /dev/reversi.
+
+    Every thread opens the device, so it gets a game of its own, and plays
+    full games against the CPU over the text protocol until time runs out.
+    Each command is timed from its write() to the read() of its response.
+    At the end the commands/sec and the p50/p99/p999 latency of each
+    command type are printed.
+
+    Usage: reversiBench [-t threads] [-s seconds] [-d depth] [-p policy] [-a]
+        policy is how the user side picks its move from the legal ones:
+        first, random or greedy (flips the most discs)
+        -a starts every game with '00 X A', so the CPU answers each 02 and
+        04 itself and no 03 is ever sent
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+#define RESP_MAX    1024
+#define BOARD_LEN   67
+#define CMD_TYPES   5
+
+enum policy {
+    POLICY_FIRST,
+    POLICY_RANDOM,
+    POLICY_GREEDY
+};
+
+static const char *policyNames[] = { "first", "random", "greedy" };
+
+/* Latencies of one command type, in nanoseconds */
+struct samples {
+    uint64_t *ns;
+    size_t count;
+    size_t size;
+};
+
+struct worker {
+    pthread_t thread;
+    int id;
+    unsigned int seed;
+    unsigned long games, wins, losses, ties;
+    struct samples lat[CMD_TYPES];
+};
+
+static int depth = 4;
+static enum policy policy = POLICY_RANDOM;
+static int autoReply;
+static volatile int stop;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void add_sample(struct samples *s, uint64_t ns) {
+    if(s->count == s->size) {
+        s->size = s->size ? s->size * 2 : 4096;
+        s->ns = realloc(s->ns, s->size * sizeof(*s->ns));
+
+        if(!s->ns) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    s->ns[s->count++] = ns;
+}
+
+/* Sends one command and reads its whole response, timing the round trip */
+static ssize_t command(struct worker *w, int fd, int type, const char *cmd,
+                       char *resp) {
+    uint64_t start = now_ns();
+    ssize_t rv;
+
+    if(write(fd, cmd, strlen(cmd)) < 0) {
+        perror("write");
+        exit(EXIT_FAILURE);
+    }
+
+    if((rv = read(fd, resp, RESP_MAX - 1)) < 0) {
+        perror("read");
+        exit(EXIT_FAILURE);
+    }
+
+    add_sample(&w->lat[type], now_ns() - start);
+    resp[rv] = 0;
+    return rv;
+}
+
+/* Discs move flips for own, the same way the module works them out */
+static uint64_t shift(uint64_t b, int dir) {
+    static const int shifts[8] = { -8, 8, -1, 1, -9, -7, 9, 7 };
+    static const uint64_t masks[8] = {
+        ~0ULL, ~0ULL, 0x7f7f7f7f7f7f7f7fULL, 0xfefefefefefefefeULL,
+        0x7f7f7f7f7f7f7f7fULL, 0xfefefefefefefefeULL,
+        0xfefefefefefefefeULL, 0x7f7f7f7f7f7f7f7fULL
+    };
+
+    return (shifts[dir] > 0 ? b << shifts[dir] : b >> -shifts[dir]) &
+        masks[dir];
+}
+
+static uint64_t flips(uint64_t own, uint64_t opp, int sq) {
+    uint64_t all = 0, line, b;
+    int dir;
+
+    if((own | opp) & (1ULL << sq))
+        return 0;
+
+    for(dir = 0; dir < 8; ++dir) {
+        line = 0;
+
+        for(b = shift(1ULL << sq, dir); b & opp; b = shift(b, dir))
+            line |= b;
+
+        if(b & own)
+            all |= line;
+    }
+
+    return all;
+}
+
+/* Picks the user's move from a "01" board, -1 if there is none */
+static int pick_move(struct worker *w, const char *bd, char piece) {
+    uint64_t own = 0, opp = 0, f;
+    int sq, best = -1, bestCount = 0, count, legal = 0;
+
+    for(sq = 0; sq < 64; ++sq) {
+        if(bd[sq] == piece)
+            own |= 1ULL << sq;
+        else if(bd[sq] != '-')
+            opp |= 1ULL << sq;
+    }
+
+    for(sq = 0; sq < 64; ++sq) {
+        if(!(f = flips(own, opp, sq)))
+            continue;
+
+        ++legal;
+        count = __builtin_popcountll(f);
+
+        switch(policy) {
+            case POLICY_FIRST:
+                return sq;
+
+            case POLICY_RANDOM:
+                /* Reservoir sampling, every legal move equally likely */
+                if(rand_r(&w->seed) % legal == 0)
+                    best = sq;
+                break;
+
+            case POLICY_GREEDY:
+                if(count > bestCount) {
+                    best = sq;
+                    bestCount = count;
+                }
+                break;
+        }
+    }
+
+    return best;
+}
+
+/* Cuts an auto reply such as "OK 2 4\n" down to its "OK\n" */
+static void strip_reply(char *resp) {
+    char *sp = strchr(resp, ' ');
+
+    if(sp)
+        strcpy(sp, "\n");
+}
+
+/* Plays one game, returns once it is over */
+static void play_game(struct worker *w, int fd) {
+    char cmd[16], resp[RESP_MAX], piece;
+    int sq;
+
+    /* Alternates who goes first */
+    piece = (w->games & 1) ? 'O' : 'X';
+    snprintf(cmd, sizeof(cmd), "00 %c %d%s\n", piece, depth,
+             autoReply ? " A" : "");
+    command(w, fd, 0, cmd, resp);
+    strip_reply(resp);
+
+    if(strcmp(resp, "OK\n")) {
+        fprintf(stderr, "Thread %d: unexpected response to 00: %s", w->id,
+                resp);
+        exit(EXIT_FAILURE);
+    }
+
+    for(;;) {
+        if(command(w, fd, 1, "01\n", resp) != BOARD_LEN) {
+            fprintf(stderr, "Thread %d: bad board: %s\n", w->id, resp);
+            exit(EXIT_FAILURE);
+        }
+
+        if(resp[BOARD_LEN - 2] == piece) {
+            if((sq = pick_move(w, resp, piece)) >= 0) {
+                snprintf(cmd, sizeof(cmd), "02 %d %d\n", sq % 8, sq / 8);
+                command(w, fd, 2, cmd, resp);
+            }
+            else {
+                command(w, fd, 4, "04\n", resp);
+            }
+
+            strip_reply(resp);
+        }
+        else {
+            command(w, fd, 3, "03\n", resp);
+        }
+
+        if(!strcmp(resp, "WIN\n"))
+            ++w->wins;
+        else if(!strcmp(resp, "LOSE\n"))
+            ++w->losses;
+        else if(!strcmp(resp, "TIE\n"))
+            ++w->ties;
+        else if(!strcmp(resp, "OK\n"))
+            continue;
+        else {
+            fprintf(stderr, "Thread %d: unexpected response: %s", w->id,
+                    resp);
+            exit(EXIT_FAILURE);
+        }
+
+        ++w->games;
+        return;
+    }
+}
+
+static void *worker_main(void *arg) {
+    struct worker *w = (struct worker *)arg;
+    int fd;
+
+    if((fd = open("/dev/reversi", O_RDWR)) < 0) {
+        perror("Cannot open /dev/reversi");
+        exit(EXIT_FAILURE);
+    }
+
+    while(!stop)
+        play_game(w, fd);
+
+    close(fd);
+    return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static double percentile(const struct samples *s, double p) {
+    size_t i = (size_t)(p * (s->count - 1) + 0.5);
+
+    return s->ns[i] / 1000.0;
+}
+
+int main(int argc, char *argv[]) {
+    struct worker *workers;
+    struct samples all[CMD_TYPES];
+    double seconds = 10.0, elapsed;
+    int threads = 1, i, t, opt;
+    unsigned long games = 0, wins = 0, losses = 0, ties = 0;
+    size_t total = 0;
+    uint64_t start;
+
+    while((opt = getopt(argc, argv, "t:s:d:p:a")) != -1) {
+        switch(opt) {
+            case 't':
+                threads = atoi(optarg);
+                break;
+
+            case 's':
+                seconds = atof(optarg);
+                break;
+
+            case 'd':
+                depth = atoi(optarg);
+                break;
+
+            case 'p':
+                for(i = 0; i < 3; ++i) {
+                    if(!strcmp(optarg, policyNames[i]))
+                        break;
+                }
+
+                if(i == 3) {
+                    fprintf(stderr, "Unknown policy: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+
+                policy = (enum policy)i;
+                break;
+
+            case 'a':
+                autoReply = 1;
+                break;
+
+            default:
+                fprintf(stderr, "Usage: %s [-t threads] [-s seconds] "
+                        "[-d depth] [-p first|random|greedy] [-a]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if(threads < 1 || depth < 1 || depth > 12) {
+        fprintf(stderr, "Need at least one thread and a depth of 1-12\n");
+        return EXIT_FAILURE;
+    }
+
+    workers = calloc(threads, sizeof(*workers));
+    start = now_ns();
+
+    for(t = 0; t < threads; ++t) {
+        workers[t].id = t;
+        workers[t].seed = (unsigned int)(start + t);
+        pthread_create(&workers[t].thread, NULL, worker_main, &workers[t]);
+    }
+
+    usleep((useconds_t)(seconds * 1e6));
+    stop = 1;
+
+    for(t = 0; t < threads; ++t)
+        pthread_join(workers[t].thread, NULL);
+
+    elapsed = (now_ns() - start) / 1e9;
+
+    /* Merges every thread's samples per command type */
+    memset(all, 0, sizeof(all));
+
+    for(t = 0; t < threads; ++t) {
+        games += workers[t].games;
+        wins += workers[t].wins;
+        losses += workers[t].losses;
+        ties += workers[t].ties;
+
+        for(i = 0; i < CMD_TYPES; ++i) {
+            for(size_t j = 0; j < workers[t].lat[i].count; ++j)
+                add_sample(&all[i], workers[t].lat[i].ns[j]);
+
+            free(workers[t].lat[i].ns);
+        }
+    }
+
+    printf("%d thread(s), depth %d, %s policy, %.1f s\n", threads, depth,
+           policyNames[policy], elapsed);
+    printf("%lu games (user %lu won, %lu lost, %lu tied)\n", games, wins,
+           losses, ties);
+    printf("\n%-4s %10s %12s %10s %10s %10s %10s\n", "cmd", "count",
+           "per sec", "p50 us", "p99 us", "p999 us", "max us");
+
+    for(i = 0; i < CMD_TYPES; ++i) {
+        total += all[i].count;
+
+        if(!all[i].count)
+            continue;
+
+        qsort(all[i].ns, all[i].count, sizeof(uint64_t), cmp_u64);
+        printf("0%-3d %10zu %12.0f %10.1f %10.1f %10.1f %10.1f\n", i,
+               all[i].count, all[i].count / elapsed, percentile(&all[i], 0.5),
+               percentile(&all[i], 0.99), percentile(&all[i], 0.999),
+               all[i].ns[all[i].count - 1] / 1000.0);
+        free(all[i].ns);
+    }
+
+    printf("all  %10zu %12.0f\n", total, total / elapsed);
+    free(workers);
+    return EXIT_SUCCESS;
+}
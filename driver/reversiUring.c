@@ -0,0 +1,239 @@
+/*
+    reversiUring.c -- Drives many games through one io_uring.
+
+    Opens the device once per game, so each has a game of its own, and
+    plays them all against the CPU through IORING_OP_URING_CMD instead of
+    write() and read(). Every game always has one command in flight, the
+    next one is queued as soon as its completion comes back and the whole
+    batch goes in with a single io_uring_submit_and_wait(). The user side
+    plays a random legal move, found with GET_MOVES from the CQE.
+
+    Needs liburing and a kernel with CONFIG_IO_URING and 32 byte CQEs,
+    and one file descriptor per game, so raise ulimit -n for big -g.
+
+    Usage: reversiUring [-g games] [-s seconds] [-d depth]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <liburing.h>
+
+#include "reversi_ioctl.h"
+
+struct game {
+    int fd;
+    __u32 piece;
+    unsigned int seed;
+};
+
+static struct io_uring ring;
+static unsigned long commands, finished, wins, losses, ties;
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Queues one command for game i, arg goes in the SQE's cmd area */
+static void queue(int i, struct game *g, __u32 op, const void *arg,
+                  size_t len) {
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+
+    if(!sqe) {
+        io_uring_submit(&ring);
+        sqe = io_uring_get_sqe(&ring);
+    }
+
+    io_uring_prep_rw(IORING_OP_URING_CMD, sqe, g->fd, NULL, 0, 0);
+    sqe->cmd_op = op;
+
+    if(len)
+        memcpy(sqe->cmd, arg, len);
+
+    /* The op in the top bits so the completion knows what it was for */
+    io_uring_sqe_set_data64(sqe, (__u64)_IOC_NR(op) << 32 | i);
+}
+
+static void new_game(int i, struct game *g, int depth) {
+    struct reversi_new_game ng;
+
+    /* Alternates who goes first */
+    g->piece = g->piece == REVERSI_X ? REVERSI_O : REVERSI_X;
+    ng.piece = g->piece;
+    ng.depth = depth;
+    queue(i, g, REVERSI_IOC_NEW_GAME, &ng, sizeof(ng));
+}
+
+/* Picks a random square out of a non-empty move mask */
+static int random_move(struct game *g, __u64 moves) {
+    int n = rand_r(&g->seed) % __builtin_popcountll(moves);
+
+    while(n-- > 0)
+        moves &= moves - 1;
+
+    return __builtin_ctzll(moves);
+}
+
+int main(int argc, char *argv[]) {
+    struct io_uring_params p;
+    struct io_uring_cqe *cqe;
+    struct reversi_move mv;
+    struct game *games;
+    double seconds = 10.0, start, elapsed;
+    int count = 64, depth = 1, inFlight, opt, i, ret, sq;
+    unsigned int head, seen;
+    __u64 res2;
+
+    while((opt = getopt(argc, argv, "g:s:d:")) != -1) {
+        switch(opt) {
+            case 'g':
+                count = atoi(optarg);
+                break;
+
+            case 's':
+                seconds = atof(optarg);
+                break;
+
+            case 'd':
+                depth = atoi(optarg);
+                break;
+
+            default:
+                fprintf(stderr, "Usage: %s [-g games] [-s seconds] "
+                        "[-d depth]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if(count < 1 || depth < 1 || depth > 12) {
+        fprintf(stderr, "Need at least one game and a depth of 1-12\n");
+        return EXIT_FAILURE;
+    }
+
+    /* One command per game at a time, so that many entries always do */
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQE32;
+
+    if((ret = io_uring_queue_init_params(count, &ring, &p)) < 0) {
+        fprintf(stderr, "Cannot set up the ring: %s\n", strerror(-ret));
+        return EXIT_FAILURE;
+    }
+
+    games = calloc(count, sizeof(*games));
+
+    for(i = 0; i < count; ++i) {
+        if((games[i].fd = open("/dev/reversi", O_RDWR)) < 0) {
+            fprintf(stderr, "Cannot open /dev/reversi for game %d: %s\n", i,
+                    strerror(errno));
+            return EXIT_FAILURE;
+        }
+
+        games[i].seed = i;
+        new_game(i, &games[i], depth);
+    }
+
+    inFlight = count;
+    start = now();
+
+    while(inFlight > 0) {
+        io_uring_submit_and_wait(&ring, 1);
+        elapsed = now() - start;
+        seen = 0;
+
+        io_uring_for_each_cqe(&ring, head, cqe) {
+            struct game *g;
+            __u32 op;
+
+            ++seen;
+            ++commands;
+            i = (int)(cqe->user_data & 0xffffffff);
+            op = (__u32)(cqe->user_data >> 32);
+            g = &games[i];
+            res2 = cqe->big_cqe[0];
+
+            if(cqe->res < 0) {
+                fprintf(stderr, "Game %d: command %u failed: %s\n", i, op,
+                        strerror(-cqe->res));
+
+                if(cqe->res == -EOPNOTSUPP || cqe->res == -EINVAL)
+                    fprintf(stderr, "Is the module built with io_uring?\n");
+
+                return EXIT_FAILURE;
+            }
+
+            switch(op) {
+                case _IOC_NR(REVERSI_IOC_NEW_GAME):
+                    queue(i, g, REVERSI_IOC_GET_MOVES, NULL, 0);
+                    break;
+
+                case _IOC_NR(REVERSI_IOC_GET_MOVES):
+                    /* res is the side to move and res2 its moves */
+                    if((__u32)cqe->res != g->piece) {
+                        queue(i, g, REVERSI_IOC_CPU_MOVE, NULL, 0);
+                    }
+                    else if(res2) {
+                        sq = random_move(g, res2);
+                        memset(&mv, 0, sizeof(mv));
+                        mv.col = sq % 8;
+                        mv.row = sq / 8;
+                        queue(i, g, REVERSI_IOC_MOVE, &mv, sizeof(mv));
+                    }
+                    else {
+                        queue(i, g, REVERSI_IOC_PASS, NULL, 0);
+                    }
+                    break;
+
+                default:
+                    /* MOVE, PASS and CPU_MOVE, res is the status */
+                    if(cqe->res == REVERSI_OK) {
+                        queue(i, g, REVERSI_IOC_GET_MOVES, NULL, 0);
+                        break;
+                    }
+
+                    if(cqe->res == REVERSI_WIN)
+                        ++wins;
+                    else if(cqe->res == REVERSI_LOSE)
+                        ++losses;
+                    else if(cqe->res == REVERSI_TIE)
+                        ++ties;
+                    else {
+                        fprintf(stderr, "Game %d: unexpected status %d\n", i,
+                                cqe->res);
+                        return EXIT_FAILURE;
+                    }
+
+                    ++finished;
+
+                    /* Once time is up games finish and are not replaced */
+                    if(elapsed < seconds)
+                        new_game(i, g, depth);
+                    else
+                        --inFlight;
+                    break;
+            }
+        }
+
+        io_uring_cq_advance(&ring, seen);
+    }
+
+    elapsed = now() - start;
+    printf("%d games in flight, depth %d, %.2f s\n", count, depth, elapsed);
+    printf("games finished: %lu (user won %lu, lost %lu, tied %lu)\n",
+           finished, wins, losses, ties);
+    printf("commands: %lu, %.0f/s, %.1f per game\n", commands,
+           commands / elapsed, finished ? (double)commands / finished : 0.0);
+
+    for(i = 0; i < count; ++i)
+        close(games[i].fd);
+
+    io_uring_queue_exit(&ring);
+    free(games);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,47 @@
+/* Just enough of the kernel's headers for reversi_engine.c to build as
+   plain userspace C, see test/Makefile. Never used by the module */
+#ifndef REVERSI_COMPAT_H
+#define REVERSI_COMPAT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <errno.h>
+
+typedef unsigned long long u64;
+typedef uint32_t u32;
+typedef uint8_t u8;
+
+#define BIT_ULL(n)	(1ULL << (n))
+#define ARRAY_SIZE(a)	(sizeof(a) / sizeof((a)[0]))
+#define hweight64(x)	((unsigned int)__builtin_popcountll(x))
+#define __ffs64(x)	((unsigned long)__builtin_ctzll(x))
+#define READ_ONCE(x)	(*(const volatile __typeof__(x) *)&(x))
+#define WRITE_ONCE(x, v)	(*(volatile __typeof__(x) *)&(x) = (v))
+#define ____cacheline_aligned	__attribute__((aligned(64)))
+#define min(a, b)	((a) < (b) ? (a) : (b))
+#define rounddown_pow_of_two(n)	((size_t)1 << (63 - __builtin_clzll(n)))
+#define vzalloc(size)	calloc(1, size)
+#define vfree(p)	free(p)
+
+/* A fixed seed instead of real randomness, so node counts and the moves
+   picked are the same from run to run */
+static inline void get_random_bytes(void *buf, size_t len)
+{
+	static u64 state = 0x9e3779b97f4a7c15ULL;
+	u8 *out = buf;
+	u64 z;
+	size_t i;
+	for(i = 0; i < len; i++)
+	{
+		/* splitmix64, one byte of each output */
+		z = (state += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		out[i] = (u8)(z ^ (z >> 31));
+	}
+}
+
+#endif
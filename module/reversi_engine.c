@@ -0,0 +1,798 @@
+#ifdef __KERNEL__
+#include <linux/kernel.h>
+#include <linux/bitops.h>
+#include <linux/vmalloc.h>
+#include <linux/random.h>
+#include <linux/log2.h>
+#include <linux/cache.h>
+#endif
+
+#include "reversi_engine.h"
+
+/* Transposition table layout. Buckets are one cache line of TT_BUCKET
+   entries, and each entry packs its data into one u64 (see TT_PACK) */
+#define TT_BUCKET	4
+#define TT_EXACT	1 /* score is the real value */
+#define TT_LOWER	2 /* score is at least this, search failed high */
+#define TT_UPPER	3 /* score is at most this, search failed low */
+#define TT_NO_MOVE	64
+#define TT_PACK(score, depth, bound, move, gen) \
+	((u64)(u32)(score) | (u64)(depth) << 32 | (u64)(bound) << 40 | \
+	 (u64)(move) << 48 | (u64)(gen) << 56)
+#define TT_SCORE(data)	((int)(u32)(data))
+#define TT_DEPTH(data)	((int)((data) >> 32) & 0xff)
+#define TT_BOUND(data)	((int)((data) >> 40) & 0xff)
+#define TT_MOVE(data)	((int)((data) >> 48) & 0xff)
+#define TT_GEN(data)	((u8)((data) >> 56))
+
+/* The eight directions as a shift plus the mask that throws away anything
+   that wrapped around the edge of the board on the way */
+static const struct
+{
+	int shift;
+	u64 mask;
+} bbDirs[8] =
+{
+	{ -8, ~0ULL },		/* up */
+	{  8, ~0ULL },		/* down */
+	{ -1, BB_NOT_H },	/* left */
+	{  1, BB_NOT_A },	/* right */
+	{ -9, BB_NOT_H },	/* up left */
+	{ -7, BB_NOT_A },	/* up right */
+	{  9, BB_NOT_A },	/* down right */
+	{  7, BB_NOT_H },	/* down left */
+};
+
+/* Tables for bb_flips, filled in by flip_init. Each of the four lines
+   through a square is gathered into one byte, bit i for the i-th square
+   along it, and the flips on that line are then two lookups:
+   flipOutflank has the squares a run of opp from position p could end
+   on, which only count if own is there, and flipLine the squares between
+   p and those ends. Rows and diagonals are indexed by column, columns by
+   row */
+#define BB_FILE_A	0x0101010101010101ULL /* also copies a byte to every row */
+#define BB_FILE_GATHER	0x0102040810204080ULL /* column 0 into the top byte */
+static u8 flipOutflank[8][64]; /* by p and the six inner squares of opp */
+static u8 flipLine[8][256]; /* by p and the ends own holds */
+static u64 flipColumn[256]; /* a column's byte back onto column 0 */
+static u64 flipDiag[64]; /* the down right diagonal through each square */
+static u64 flipAnti[64]; /* and the down left one */
+
+/* Order the search tries moves in, best squares first. Walking the legal
+   moves one group at a time gives decent ordering without any sorting */
+static const u64 moveOrder[5] =
+{
+	BB_CORNERS,
+	BB_EDGES & ~BB_CORNERS & ~BB_C_SQUARES,
+	~BB_EDGES & ~BB_X_SQUARES,
+	BB_C_SQUARES,
+	BB_X_SQUARES,
+};
+/* What a disc on each of the groups above is worth to the evaluation */
+static const int orderWeight[5] = { 20, 4, 1, -4, -8 };
+
+/* The four 4x4 corners of the board. In the endgame a region with an odd
+   number of empties is where the last move, and so the advantage, lands */
+static const u64 quadrants[4] =
+{
+	0x000000000f0f0f0fULL,
+	0x00000000f0f0f0f0ULL,
+	0x0f0f0f0f00000000ULL,
+	0xf0f0f0f000000000ULL,
+};
+
+/* One transposition table entry. check is the key xor'd with data, so a
+   lookup racing with a store from another game's search just misses */
+struct tt_entry
+{
+	u64 check;
+	u64 data;
+};
+
+struct tt_bucket
+{
+	struct tt_entry e[TT_BUCKET];
+} ____cacheline_aligned;
+
+/* The transposition table is shared by every game and allocated once in
+   engine_init. Positions are keyed by Zobrist hashes: a random number per
+   piece per square, plus one for O being the side to move */
+static struct tt_bucket *ttTable;
+static u64 ttMask; /* number of buckets minus one */
+static u8 ttGeneration; /* bumped every search so old entries go first */
+static u64 zobrist[2][64];
+u64 zobristSide;
+
+static void	flip_init(void);
+static inline u8	flip_line(int p, u8 own, u8 opp);
+static int	evaluate(u64 own, u64 opp);
+static int	search_node(struct search_ctx *ctx, u64 own, u64 opp, u64 key,
+			    int color, int depth, int alpha, int beta, bool passed);
+static int	solve_final(u64 own, u64 opp);
+static int	solve_last1(struct search_ctx *ctx, u64 own, u64 opp, int sq);
+static int	solve_last2(struct search_ctx *ctx, u64 own, u64 opp, int alpha,
+			    int beta, bool passed);
+static int	solve_node(struct search_ctx *ctx, u64 own, u64 opp, int alpha,
+			   int beta, bool passed);
+static void	analyze_sort(struct move_score *scores, int n);
+static bool	tt_probe(struct search_ctx *ctx, u64 key, u64 *data);
+static void	tt_store(struct search_ctx *ctx, u64 key, int depth, int bound,
+			 int score, int move);
+
+int engine_init(int ttMb)
+{	/* fills in the flip tables, picks the Zobrist numbers and allocates
+	   the table, ttMb 0 means searching without one. bb_flips and so
+	   everything after it needs this first */
+	size_t buckets;
+	flip_init();
+	get_random_bytes(zobrist, sizeof(zobrist));
+	get_random_bytes(&zobristSide, sizeof(zobristSide));
+	if(ttMb > 0)
+	{
+		buckets = ((size_t)min(ttMb, 4096) << 20) / sizeof(struct tt_bucket);
+		buckets = rounddown_pow_of_two(buckets);
+		ttTable = vzalloc(buckets * sizeof(struct tt_bucket));
+		if(ttTable == NULL)
+		{
+			return -ENOMEM;
+		}
+		ttMask = buckets - 1;
+	}
+	return 0;
+}
+
+void engine_exit(void)
+{
+	vfree(ttTable);
+	ttTable = NULL;
+}
+
+u8 engine_new_search(void)
+{	/* generation for a new search, entries from earlier searches are the
+	   first to be replaced */
+	u8 gen = READ_ONCE(ttGeneration) + 1;
+	WRITE_ONCE(ttGeneration, gen);
+	return gen;
+}
+
+/* Shifts a bitboard towards a direction, negative shifts go right */
+static inline u64 bb_shift(u64 b, int shift)
+{
+	return shift > 0 ? b << shift : b >> -shift;
+}
+
+/* Kogge-Stone fill: grows gen along one direction through the squares in
+   pro, doubling the distance covered each step. pro has already had the
+   wrapped edge taken out, so three steps cover the longest possible run */
+static inline u64 bb_fill(u64 gen, u64 pro, int shift)
+{
+	gen |= pro & bb_shift(gen, shift);
+	pro &= bb_shift(pro, shift);
+	gen |= pro & bb_shift(gen, 2 * shift);
+	pro &= bb_shift(pro, 2 * shift);
+	gen |= pro & bb_shift(gen, 4 * shift);
+	return gen;
+}
+
+u64 bb_moves(u64 own, u64 opp)
+{	/* every empty square next to a run of opp that ends in own */
+	u64 empty = ~(own | opp);
+	u64 moves = 0, pro, run;
+	int i;
+	for(i = 0; i < 8; i++)
+	{
+		pro = opp & bbDirs[i].mask;
+		run = bb_fill(bb_shift(own, bbDirs[i].shift) & pro, pro, bbDirs[i].shift);
+		moves |= bb_shift(run, bbDirs[i].shift) & bbDirs[i].mask & empty;
+	}
+	return moves;
+}
+
+static void flip_init(void)
+{	/* fills in the bb_flips tables, the same every time */
+	int p, q, i, sq;
+	u8 out, line;
+	u64 col;
+	for(p = 0; p < 8; p++)
+	{
+		for(i = 0; i < 64; i++)
+		{
+			/* opp is bits 1 to 6 of the line, the ends can only cap */
+			out = 0;
+			q = p + 1;
+			while(q < 7 && (i & (1 << (q - 1))))
+			{
+				q++;
+			}
+			if(q > p + 1 && q < 8)
+			{
+				out |= 1 << q;
+			}
+			q = p - 1;
+			while(q > 0 && (i & (1 << (q - 1))))
+			{
+				q--;
+			}
+			if(q < p - 1 && q >= 0)
+			{
+				out |= 1 << q;
+			}
+			flipOutflank[p][i] = out;
+		}
+		for(i = 0; i < 256; i++)
+		{
+			line = 0;
+			for(q = 0; q < 8; q++)
+			{
+				if((i & (1 << q)) && q > p)
+				{
+					line |= ((1 << q) - 1) & ~((2 << p) - 1);
+				}
+				else if((i & (1 << q)) && q < p)
+				{
+					line |= ((1 << p) - 1) & ~((2 << q) - 1);
+				}
+			}
+			flipLine[p][i] = line;
+		}
+	}
+	for(i = 0; i < 256; i++)
+	{
+		col = 0;
+		for(q = 0; q < 8; q++)
+		{
+			if(i & (1 << q))
+			{
+				col |= 1ULL << (8 * q);
+			}
+		}
+		flipColumn[i] = col;
+	}
+	for(sq = 0; sq < 64; sq++)
+	{
+		flipDiag[sq] = 0;
+		flipAnti[sq] = 0;
+		for(i = 0; i < 64; i++)
+		{
+			if(i / 8 - i % 8 == sq / 8 - sq % 8)
+			{
+				flipDiag[sq] |= 1ULL << i;
+			}
+			if(i / 8 + i % 8 == sq / 8 + sq % 8)
+			{
+				flipAnti[sq] |= 1ULL << i;
+			}
+		}
+	}
+}
+
+static inline u8 flip_line(int p, u8 own, u8 opp)
+{	/* flips along one gathered line for a move at position p */
+	return flipLine[p][flipOutflank[p][(opp >> 1) & 0x3f] & own];
+}
+
+u64 bb_flips(u64 own, u64 opp, int sq)
+{	/* runs of opp leading away from sq that are capped by own, a few
+	   table lookups per line however many discs turn over */
+	int col = sq & 7, row = sq >> 3;
+	u64 flips;
+	u8 o, x;
+	if((own | opp) & (1ULL << sq)) /* taken squares are never legal */
+	{
+		return 0;
+	}
+	/* the row is already a byte */
+	flips = (u64)flip_line(col, own >> (8 * row), opp >> (8 * row)) << (8 * row);
+	/* the column, gathered a square per row into the top byte */
+	x = (((own >> col) & BB_FILE_A) * BB_FILE_GATHER) >> 56;
+	o = (((opp >> col) & BB_FILE_A) * BB_FILE_GATHER) >> 56;
+	flips |= flipColumn[flip_line(row, x, o)] << col;
+	/* the diagonals have one square per column, so every row of the
+	   product holds all of them and the top one can be read off */
+	x = ((own & flipDiag[sq]) * BB_FILE_A) >> 56;
+	o = ((opp & flipDiag[sq]) * BB_FILE_A) >> 56;
+	flips |= (flip_line(col, x, o) * BB_FILE_A) & flipDiag[sq];
+	x = ((own & flipAnti[sq]) * BB_FILE_A) >> 56;
+	o = ((opp & flipAnti[sq]) * BB_FILE_A) >> 56;
+	flips |= (flip_line(col, x, o) * BB_FILE_A) & flipAnti[sq];
+	return flips;
+}
+
+static int evaluate(u64 own, u64 opp)
+{	/* positional weight of each side's discs plus how many moves each has */
+	int score = 0, i;
+	for(i = 0; i < (int)ARRAY_SIZE(moveOrder); i++)
+	{
+		score += orderWeight[i] * ((int)hweight64(own & moveOrder[i]) -
+					   (int)hweight64(opp & moveOrder[i]));
+	}
+	score += 3 * ((int)hweight64(bb_moves(own, opp)) -
+		      (int)hweight64(bb_moves(opp, own)));
+	return score;
+}
+
+/* Negamax with alpha-beta pruning, scores are from own's point of view.
+   key is the Zobrist hash of the position and color is PIECE_IDX of own.
+   A pass does not use up depth but two in a row end the game, so there
+   are never more than 2 * depth + 1 frames on the stack */
+static int search_node(struct search_ctx *ctx, u64 own, u64 opp, u64 key,
+		       int color, int depth, int alpha, int beta, bool passed)
+{
+	u64 moves, first, group, flips, data;
+	int i, sq, score, bound;
+	int best = -SCORE_INF;
+	int bestSq = TT_NO_MOVE;
+	int alphaOrig = alpha;
+
+	ctx->nodes++;
+	if(depth == 0)
+	{
+		return evaluate(own, opp);
+	}
+	moves = bb_moves(own, opp);
+	if(moves == 0)
+	{
+		if(passed) /* neither side can move, the game is over */
+		{
+			return SCORE_DISC * ((int)hweight64(own) - (int)hweight64(opp));
+		}
+		return -search_node(ctx, opp, own, key ^ zobristSide, !color, depth,
+				    -beta, -alpha, true);
+	}
+	/* a deep enough stored result can answer outright, otherwise its best
+	   move is still the best guess for which move to try first */
+	first = 0;
+	if(tt_probe(ctx, key, &data))
+	{
+		score = TT_SCORE(data);
+		bound = TT_BOUND(data);
+		if(TT_DEPTH(data) >= depth &&
+		   (bound == TT_EXACT || (bound == TT_LOWER && score >= beta) ||
+		    (bound == TT_UPPER && score <= alpha)))
+		{
+			return score;
+		}
+		if(TT_MOVE(data) != TT_NO_MOVE)
+		{
+			first = moves & BIT_ULL(TT_MOVE(data));
+		}
+	}
+	for(i = -1; i < (int)ARRAY_SIZE(moveOrder) && alpha < beta; i++)
+	{
+		group = i < 0 ? first : moves & moveOrder[i] & ~first;
+		while(group != 0)
+		{
+			sq = __ffs64(group);
+			group &= group - 1;
+			flips = bb_flips(own, opp, sq);
+			score = -search_node(ctx, opp & ~flips, own | flips | BIT_ULL(sq),
+					     zobrist_move(key, color, sq, flips), !color,
+					     depth - 1, -beta, -alpha, false);
+			if(score > best)
+			{
+				best = score;
+				bestSq = sq;
+				if(best > alpha)
+				{
+					alpha = best;
+				}
+				if(alpha >= beta) /* the opponent will never allow this */
+				{
+					break;
+				}
+			}
+		}
+	}
+	if(best <= alphaOrig)
+	{
+		bound = TT_UPPER;
+	}
+	else if(best >= beta)
+	{
+		bound = TT_LOWER;
+	}
+	else
+	{
+		bound = TT_EXACT;
+	}
+	tt_store(ctx, key, depth, bound, best, bestSq);
+	return best;
+}
+
+int search_root(struct search_ctx *ctx, u64 own, u64 opp, u64 key,
+		       int color, int depth, int *bestSq)
+{	/* same as search_node but remembers which move was best, -1 if none.
+	   Searches one ply deeper each pass, so every pass starts from the
+	   best move so far and the table is already warm */
+	u64 moves, first, group, flips;
+	int i, d, sq, score, alpha, best;
+
+	*bestSq = -1;
+	moves = bb_moves(own, opp);
+	if(moves == 0)
+	{	/* a pass, search_node scores what the other side does next or
+		   the finished game, instead of leaving -SCORE_INF */
+		return search_node(ctx, own, opp, key, color, depth,
+				   -SCORE_INF, SCORE_INF, false);
+	}
+	alpha = -SCORE_INF;
+	for(d = 1; d <= depth; d++)
+	{
+		ctx->nodes++;
+		first = *bestSq >= 0 ? BIT_ULL(*bestSq) : 0;
+		alpha = -SCORE_INF;
+		best = -1;
+		for(i = -1; i < (int)ARRAY_SIZE(moveOrder); i++)
+		{
+			group = i < 0 ? first : moves & moveOrder[i] & ~first;
+			while(group != 0)
+			{
+				sq = __ffs64(group);
+				group &= group - 1;
+				flips = bb_flips(own, opp, sq);
+				score = -search_node(ctx, opp & ~flips,
+						     own | flips | BIT_ULL(sq),
+						     zobrist_move(key, color, sq, flips),
+						     !color, d - 1, -SCORE_INF, -alpha, false);
+				if(best < 0 || score > alpha)
+				{
+					alpha = score;
+					best = sq;
+				}
+			}
+		}
+		*bestSq = best;
+		tt_store(ctx, key, d, TT_EXACT, alpha, best);
+	}
+	return alpha;
+}
+
+static int solve_final(u64 own, u64 opp)
+{	/* disc difference of a finished game, the winner gets the empties */
+	int diff = (int)hweight64(own) - (int)hweight64(opp);
+	int empties = 64 - hweight64(own | opp);
+	if(diff > 0)
+	{
+		return diff + empties;
+	}
+	if(diff < 0)
+	{
+		return diff - empties;
+	}
+	return 0;
+}
+
+static int solve_last1(struct search_ctx *ctx, u64 own, u64 opp, int sq)
+{	/* one empty square left, whoever can play it does and the game ends */
+	int n, diff = (int)hweight64(own) - (int)hweight64(opp);
+	ctx->nodes++;
+	n = hweight64(bb_flips(own, opp, sq));
+	if(n != 0)
+	{
+		return diff + 2 * n + 1;
+	}
+	n = hweight64(bb_flips(opp, own, sq));
+	if(n != 0)
+	{
+		return diff - 2 * n - 1;
+	}
+	/* nobody can fill it, it goes to the winner */
+	return diff > 0 ? diff + 1 : (diff < 0 ? diff - 1 : 0);
+}
+
+static int solve_last2(struct search_ctx *ctx, u64 own, u64 opp, int alpha,
+		       int beta, bool passed)
+{	/* two empty squares left, try each then hand the other to solve_last1 */
+	u64 empty = ~(own | opp);
+	int sq1 = __ffs64(empty);
+	int sq2 = __ffs64(empty & (empty - 1));
+	int best = -SCORE_INF, score;
+	u64 flips;
+
+	ctx->nodes++;
+	flips = bb_flips(own, opp, sq1);
+	if(flips != 0)
+	{
+		best = -solve_last1(ctx, opp & ~flips, own | flips | BIT_ULL(sq1), sq2);
+		if(best >= beta)
+		{
+			return best;
+		}
+	}
+	flips = bb_flips(own, opp, sq2);
+	if(flips != 0)
+	{
+		score = -solve_last1(ctx, opp & ~flips, own | flips | BIT_ULL(sq2), sq1);
+		if(score > best)
+		{
+			best = score;
+		}
+	}
+	if(best != -SCORE_INF)
+	{
+		return best;
+	}
+	if(passed) /* neither side can use either square */
+	{
+		return solve_final(own, opp);
+	}
+	return -solve_last2(ctx, opp, own, -beta, -alpha, true);
+}
+
+/* Exact negamax over the rest of the game, scores are the final disc
+   difference for own. Moves in odd-parity quadrants go first, and with
+   enough empties left the moves are also sorted fastest-first, fewest
+   replies for the opponent first, which is what keeps the tree small */
+static int solve_node(struct search_ctx *ctx, u64 own, u64 opp, int alpha,
+		      int beta, bool passed)
+{
+	u64 empty = ~(own | opp);
+	u64 moves, odd, flips, child;
+	u8 sqs[ENDGAME_MAX_EMPTIES], keys[ENDGAME_MAX_EMPTIES];
+	int i, j, n, sq, score, key;
+	int left = hweight64(empty);
+	int best = -SCORE_INF;
+
+	switch(left)
+	{
+	case 0:
+		ctx->nodes++;
+		return solve_final(own, opp);
+	case 1:
+		return solve_last1(ctx, own, opp, __ffs64(empty));
+	case 2:
+		return solve_last2(ctx, own, opp, alpha, beta, passed);
+	}
+	ctx->nodes++;
+	moves = bb_moves(own, opp);
+	if(moves == 0)
+	{
+		if(passed)
+		{
+			return solve_final(own, opp);
+		}
+		return -solve_node(ctx, opp, own, -beta, -alpha, true);
+	}
+	odd = 0;
+	for(i = 0; i < (int)ARRAY_SIZE(quadrants); i++)
+	{
+		if(hweight64(empty & quadrants[i]) & 1)
+		{
+			odd |= quadrants[i];
+		}
+	}
+	/* lists the moves with their sort key, small keys are tried first */
+	n = 0;
+	while(moves != 0)
+	{
+		sq = __ffs64(moves);
+		moves &= moves - 1;
+		key = (odd & BIT_ULL(sq)) ? 0 : 1;
+		if(left >= ENDGAME_FASTEST_FIRST)
+		{
+			flips = bb_flips(own, opp, sq);
+			child = own | flips | BIT_ULL(sq);
+			key += 2 * hweight64(bb_moves(opp & ~flips, child));
+		}
+		/* insertion sort, there are never more moves than empties */
+		for(j = n; j > 0 && keys[j - 1] > key; j--)
+		{
+			sqs[j] = sqs[j - 1];
+			keys[j] = keys[j - 1];
+		}
+		sqs[j] = sq;
+		keys[j] = key;
+		n++;
+	}
+	for(i = 0; i < n; i++)
+	{
+		flips = bb_flips(own, opp, sqs[i]);
+		score = -solve_node(ctx, opp & ~flips, own | flips | BIT_ULL(sqs[i]),
+				    -beta, -alpha, false);
+		if(score > best)
+		{
+			best = score;
+			if(best > alpha)
+			{
+				alpha = best;
+			}
+			if(alpha >= beta)
+			{
+				break;
+			}
+		}
+	}
+	return best;
+}
+
+int solve_root(struct search_ctx *ctx, u64 own, u64 opp, int *bestSq)
+{	/* perfect move for own and the final disc difference it leads to */
+	u64 moves, flips;
+	int sq, score;
+	int alpha = -65, beta = 65; /* outside any possible disc difference */
+
+	*bestSq = -1;
+	ctx->nodes++;
+	moves = bb_moves(own, opp);
+	if(moves == 0)
+	{
+		return -solve_node(ctx, opp, own, -beta, -alpha, true);
+	}
+	while(moves != 0)
+	{
+		sq = __ffs64(moves);
+		moves &= moves - 1;
+		flips = bb_flips(own, opp, sq);
+		score = -solve_node(ctx, opp & ~flips, own | flips | BIT_ULL(sq),
+				    -beta, -alpha, false);
+		if(*bestSq < 0 || score > alpha)
+		{
+			alpha = score;
+			*bestSq = sq;
+		}
+	}
+	return alpha;
+}
+
+static void analyze_sort(struct move_score *scores, int n)
+{	/* best first, insertion sort keeps equal scores in the order they were */
+	struct move_score t;
+	int i, j;
+	for(i = 1; i < n; i++)
+	{
+		t = scores[i];
+		for(j = i; j > 0 && scores[j - 1].score < t.score; j--)
+		{
+			scores[j] = scores[j - 1];
+		}
+		scores[j] = t;
+	}
+}
+
+int analyze_root(struct search_ctx *ctx, u64 own, u64 opp, u64 key,
+		 int color, int depth, bool solve, struct move_score *scores)
+{	/* scores every legal move for own, best first, and returns how many
+	   there are. Unlike search_root each move gets the full window, so
+	   every score is exact and not just a bound under the best one. Each
+	   pass goes one ply deeper over all the moves, in the order the last
+	   pass left them, so all the moves share one warm table. With solve
+	   the scores are final disc differences from solve_node instead and
+	   depth is ignored. scores needs room for one entry per empty square */
+	u64 moves, flips;
+	int i, d, n = 0;
+
+	moves = bb_moves(own, opp);
+	while(moves != 0)
+	{
+		scores[n].sq = __ffs64(moves);
+		scores[n].score = 0;
+		moves &= moves - 1;
+		n++;
+	}
+	if(solve && n != 0)
+	{
+		ctx->nodes++;
+		for(i = 0; i < n; i++)
+		{
+			flips = bb_flips(own, opp, scores[i].sq);
+			scores[i].score = -solve_node(ctx, opp & ~flips,
+						      own | flips | BIT_ULL(scores[i].sq),
+						      -65, 65, false);
+		}
+		analyze_sort(scores, n);
+		return n;
+	}
+	for(d = 1; d <= depth && n != 0; d++)
+	{
+		ctx->nodes++;
+		for(i = 0; i < n; i++)
+		{
+			flips = bb_flips(own, opp, scores[i].sq);
+			scores[i].score = -search_node(ctx, opp & ~flips,
+						       own | flips | BIT_ULL(scores[i].sq),
+						       zobrist_move(key, color, scores[i].sq, flips),
+						       !color, d - 1, -SCORE_INF, SCORE_INF, false);
+		}
+		analyze_sort(scores, n);
+		tt_store(ctx, key, d, TT_EXACT, scores[0].score, scores[0].sq);
+	}
+	return n;
+}
+
+u64 zobrist_hash(u64 x, u64 o, bool oToMove)
+{	/* hashes a whole position from scratch, only needed for a new game */
+	u64 key = oToMove ? zobristSide : 0;
+	int sq;
+	for(sq = 0; sq < 64; sq++)
+	{
+		if(x & BIT_ULL(sq))
+		{
+			key ^= zobrist[0][sq];
+		}
+		if(o & BIT_ULL(sq))
+		{
+			key ^= zobrist[1][sq];
+		}
+	}
+	return key;
+}
+
+u64 zobrist_move(u64 key, int color, int sq, u64 flips)
+{	/* updates key for color playing sq, flipping flips, and passing the
+	   turn over. A flipped disc swaps one piece's number for the other's */
+	int b;
+	key ^= zobrist[color][sq] ^ zobristSide;
+	while(flips != 0)
+	{
+		b = __ffs64(flips);
+		flips &= flips - 1;
+		key ^= zobrist[0][b] ^ zobrist[1][b];
+	}
+	return key;
+}
+
+static bool tt_probe(struct search_ctx *ctx, u64 key, u64 *data)
+{	/* looks for key in its bucket, fills in data if it is there */
+	struct tt_bucket *b;
+	u64 d;
+	int i;
+	if(ttTable == NULL)
+	{
+		return false;
+	}
+	ctx->ttProbes++;
+	b = &ttTable[key & ttMask];
+	for(i = 0; i < TT_BUCKET; i++)
+	{
+		d = READ_ONCE(b->e[i].data);
+		if((READ_ONCE(b->e[i].check) ^ d) == key && d != 0)
+		{
+			ctx->ttHits++;
+			*data = d;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void tt_store(struct search_ctx *ctx, u64 key, int depth, int bound,
+		     int score, int move)
+{	/* writes over the same position if it is in the bucket, otherwise the
+	   entry least worth keeping: empty first, then old searches, then the
+	   shallowest */
+	struct tt_bucket *b;
+	struct tt_entry *victim = NULL;
+	u64 d;
+	int i, worth, least = INT_MAX;
+	if(ttTable == NULL)
+	{
+		return;
+	}
+	b = &ttTable[key & ttMask];
+	for(i = 0; i < TT_BUCKET; i++)
+	{
+		d = READ_ONCE(b->e[i].data);
+		if((READ_ONCE(b->e[i].check) ^ d) == key)
+		{
+			victim = &b->e[i];
+			break;
+		}
+		if(d == 0)
+		{
+			worth = -1;
+		}
+		else
+		{
+			worth = TT_DEPTH(d) + (TT_GEN(d) == ctx->ttGen ? 64 : 0);
+		}
+		if(worth < least)
+		{
+			least = worth;
+			victim = &b->e[i];
+		}
+	}
+	ctx->ttStores++;
+	d = TT_PACK(score, depth, bound, move, ctx->ttGen);
+	WRITE_ONCE(victim->check, key ^ d);
+	WRITE_ONCE(victim->data, d);
+}
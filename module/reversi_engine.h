@@ -0,0 +1,75 @@
+/* The game engine: bitboard move generation, the CPU search and the
+   endgame solver. Nothing in here knows about files, locks or the text
+   protocol, so the same source builds into the module and, through
+   reversi_compat.h, into the userspace tests in test/ */
+#ifndef REVERSI_ENGINE_H
+#define REVERSI_ENGINE_H
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#else
+#include "reversi_compat.h"
+#endif
+
+/* Deepest search a game can ask for, keeps the recursion bounded so it is
+   safe on the kernel stack (at most 2 * SEARCH_MAX_DEPTH + 1 frames) */
+#define SEARCH_MAX_DEPTH	12
+/* Scores bigger than any evaluation, a finished game is worth its disc
+   difference times SCORE_DISC so it always beats a heuristic score */
+#define SCORE_INF	1000000
+#define SCORE_DISC	1000
+/* Most empty squares the exact endgame solver will take on. Like the
+   search depth this bounds the recursion, at most 2 * 16 + 1 frames */
+#define ENDGAME_MAX_EMPTIES	16
+/* With at least this many empties the solver sorts moves fastest-first,
+   below it the sort costs more than it saves and parity alone is used */
+#define ENDGAME_FASTEST_FIRST	7
+
+/* The board is two 64-bit masks, one per piece. Square (col, row) is bit
+   8 * row + col. Colors are 0 for X and 1 for O wherever the engine needs
+   to know whose discs are whose */
+#define BB_SQ(col, row)	(1ULL << (8 * (row) + (col)))
+#define BB_NOT_A	0xfefefefefefefefeULL /* every column but 0 */
+#define BB_NOT_H	0x7f7f7f7f7f7f7f7fULL /* every column but 7 */
+#define BB_CORNERS	0x8100000000000081ULL
+#define BB_EDGES	0xff818181818181ffULL
+#define BB_C_SQUARES	0x4281000000008142ULL /* edge squares next to a corner */
+#define BB_X_SQUARES	0x0042000000004200ULL /* diagonal next to a corner */
+/* starting position, the middle four squares with O on the top left */
+#define BB_START_X	(BB_SQ(4, 3) | BB_SQ(3, 4))
+#define BB_START_O	(BB_SQ(3, 3) | BB_SQ(4, 4))
+
+/* Keeps track of one search so the cost can be reported afterwards */
+struct search_ctx
+{
+	u64 nodes; /* positions visited */
+	u64 ttProbes; /* table lookups */
+	u64 ttHits; /* lookups that found the position */
+	u64 ttStores; /* entries written */
+	u8 ttGen; /* generation this search stores with */
+};
+
+/* One root move and what analyze_root thinks of it */
+struct move_score
+{
+	int sq;
+	int score;
+};
+
+int	engine_init(int ttMb);
+void	engine_exit(void);
+u8	engine_new_search(void);
+u64	bb_moves(u64 own, u64 opp);
+u64	bb_flips(u64 own, u64 opp, int sq);
+int	search_root(struct search_ctx *ctx, u64 own, u64 opp, u64 key,
+		    int color, int depth, int *bestSq);
+int	solve_root(struct search_ctx *ctx, u64 own, u64 opp, int *bestSq);
+int	analyze_root(struct search_ctx *ctx, u64 own, u64 opp, u64 key,
+		     int color, int depth, bool solve, struct move_score *scores);
+u64	zobrist_hash(u64 x, u64 o, bool oToMove);
+u64	zobrist_move(u64 key, int color, int sq, u64 flips);
+
+/* Added to a position's key when O is the side to move */
+extern u64 zobristSide;
+
+#endif
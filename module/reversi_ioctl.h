@@ -0,0 +1,168 @@
+/* Binary interface to /dev/reversi, shared by the module and programs
+   that use it. Every ioctl mirrors one of the text commands so the two
+   can be mixed on the same file, but nothing is formatted or parsed */
+#ifndef REVERSI_IOCTL_H
+#define REVERSI_IOCTL_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/* Pieces, as they are used in every struct below */
+#define REVERSI_X	0
+#define REVERSI_O	1
+
+/* Results, the binary form of the text responses */
+#define REVERSI_OK	0
+#define REVERSI_ILLMOVE	1
+#define REVERSI_OOT	2
+#define REVERSI_NOGAME	3
+#define REVERSI_WIN	4
+#define REVERSI_LOSE	5
+#define REVERSI_TIE	6
+#define REVERSI_INVFMT	7
+#define REVERSI_UNKCMD	8
+
+/* '00', depth 0 means the module's search_depth */
+struct reversi_new_game
+{
+	__u32 piece;	/* REVERSI_X or REVERSI_O for the user */
+	__u32 depth;
+};
+
+/* reply in struct reversi_move and reversi_pass when the CPU did not
+   answer, always outside a game started with '00 X A' */
+#define REVERSI_NO_REPLY	(-2)
+
+/* '02', col and row in, status out. In an 'A' game a move that leaves the
+   CPU to move is answered straight away, status is then how the game
+   stands after the CPU's move and reply is where it went, 8 * row + col
+   or -1 for a pass */
+struct reversi_move
+{
+	__u32 col;
+	__u32 row;
+	__s32 status;
+	__s32 reply;
+};
+
+/* '03', waits for the search and reports what it played and cost.
+   col and row are -1 if the CPU had to pass */
+struct reversi_cpu_move
+{
+	__u64 nodes;	/* positions searched */
+	__u64 ns;	/* time spent searching */
+	__s32 col;
+	__s32 row;
+	__s32 status;
+	__s32 score;	/* exact final disc difference if solved is set */
+	__u32 solved;
+	__u32 reserved;
+};
+
+/* '04', answered in an 'A' game like MOVE is */
+struct reversi_pass
+{
+	__s32 status;
+	__s32 reply;
+};
+
+/* '01', bit 8 * row + col of x and o is set for each piece */
+struct reversi_board
+{
+	__u64 x;
+	__u64 o;
+	__u32 toMove;	/* REVERSI_X or REVERSI_O */
+	__u32 userPiece;
+	__u32 inGame;	/* 0 before the first '00' and once a game ends */
+	__u32 reserved;
+};
+
+/* Every legal move for the side to move, same bit layout as the board */
+struct reversi_moves
+{
+	__u64 moves;
+	__u32 toMove;
+	__u32 reserved;
+};
+
+/* '05' and '06', the id of a game any open file can move to */
+struct reversi_game_id
+{
+	__u64 id;
+};
+
+/* Layout of the read-only page mmap gives back, kept up to date after
+   every move. seq is odd while the module is changing the page, so a
+   copy taken while it was even and is still the same is consistent.
+   Userspace can use reversi_shared_read below */
+struct reversi_shared
+{
+	__u32 seq;
+	__u32 moveNumber;	/* plies played this game, passes included */
+	__u64 x;
+	__u64 o;
+	__u32 toMove;
+	__u32 userPiece;
+	__u32 status;	/* REVERSI_OK in a game, NOGAME before the first
+			   one, WIN, LOSE or TIE once it ended */
+	__u32 reserved;
+};
+
+#ifndef __KERNEL__
+/* Copies a consistent snapshot of page into snap without a syscall */
+static inline void reversi_shared_read(const struct reversi_shared *page,
+				       struct reversi_shared *snap)
+{
+	__u32 seq;
+
+	do
+	{
+		while((seq = __atomic_load_n(&page->seq, __ATOMIC_ACQUIRE)) & 1)
+			;
+		*snap = *(const volatile struct reversi_shared *)page;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while(__atomic_load_n(&page->seq, __ATOMIC_RELAXED) != seq);
+}
+#endif
+
+/* io_uring passthrough. An IORING_OP_URING_CMD SQE on the device with
+   cmd_op set to one of the REVERSI_IOC_* numbers below runs the same
+   command as the ioctl. NEW_GAME, MOVE and ATTACH_GAME take their struct
+   in the SQE's cmd area, and GET_BOARD takes a struct reversi_uring_board
+   there saying where to copy the board. cqe->res is a negative errno or
+
+	MOVE, PASS, CPU_MOVE	the REVERSI_* status
+	GET_MOVES		the side to move, REVERSI_X or REVERSI_O
+	anything else		0
+
+   and on a ring set up with IORING_SETUP_CQE32, big_cqe[0] is
+
+	MOVE, PASS		reply, sign extended, as in struct reversi_move
+	CPU_MOVE		the move, see REVERSI_URING_CPU_*
+	GET_MOVES		the legal move mask, as in struct reversi_moves
+	CREATE_GAME		the new game's id */
+struct reversi_uring_board
+{
+	__u64 addr;	/* a struct reversi_board in the submitter's memory */
+};
+
+/* CPU_MOVE's big_cqe[0], col and row are -1 if the CPU had to pass */
+#define REVERSI_URING_CPU(col, row, score, solved) \
+	((__u64)(__u8)(col) | (__u64)(__u8)(row) << 8 | \
+	 (__u64)!!(solved) << 16 | (__u64)(__u32)(score) << 32)
+#define REVERSI_URING_CPU_COL(res2)	((__s8)((res2) & 0xff))
+#define REVERSI_URING_CPU_ROW(res2)	((__s8)((res2) >> 8 & 0xff))
+#define REVERSI_URING_CPU_SOLVED(res2)	((int)((res2) >> 16 & 1))
+#define REVERSI_URING_CPU_SCORE(res2)	((__s32)((res2) >> 32))
+
+#define REVERSI_IOC_MAGIC	'R'
+#define REVERSI_IOC_NEW_GAME	_IOW(REVERSI_IOC_MAGIC, 0, struct reversi_new_game)
+#define REVERSI_IOC_GET_BOARD	_IOR(REVERSI_IOC_MAGIC, 1, struct reversi_board)
+#define REVERSI_IOC_MOVE	_IOWR(REVERSI_IOC_MAGIC, 2, struct reversi_move)
+#define REVERSI_IOC_CPU_MOVE	_IOR(REVERSI_IOC_MAGIC, 3, struct reversi_cpu_move)
+#define REVERSI_IOC_PASS	_IOR(REVERSI_IOC_MAGIC, 4, struct reversi_pass)
+#define REVERSI_IOC_GET_MOVES	_IOR(REVERSI_IOC_MAGIC, 5, struct reversi_moves)
+#define REVERSI_IOC_CREATE_GAME	_IOR(REVERSI_IOC_MAGIC, 6, struct reversi_game_id)
+#define REVERSI_IOC_ATTACH_GAME	_IOW(REVERSI_IOC_MAGIC, 7, struct reversi_game_id)
+
+#endif
@@ -0,0 +1,330 @@
+/* KUnit tests for the engine, through the same calls the module makes.
+   Linked into reversi.ko itself, so they run against the engine
+   reversi_init already set up. See test/README for running it */
+#include <kunit/test.h>
+#include <linux/module.h>
+#include <linux/prandom.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/bitops.h>
+
+#include "reversi_engine.h"
+
+/* Positions for the reference comparisons and the benchmark */
+#define CORPUS_SIZE	512
+#define BENCH_ROUNDS	200
+
+struct corpus_pos
+{
+	u64 own;
+	u64 opp;
+};
+
+static struct corpus_pos *corpus;
+
+/* The way the flips were worked out before bitboards, one square at a
+   time, but with the bounds checked properly: a step that leaves the
+   board in either coordinate ends the line */
+static u64 ref_flips(u64 own, u64 opp, int sq)
+{
+	static const int dc[8] = { 0, 0, -1, 1, -1, 1, 1, -1 };
+	static const int dr[8] = { -1, 1, 0, 0, -1, -1, 1, 1 };
+	u64 flips = 0, line;
+	int d, c, r;
+	if((own | opp) & BIT_ULL(sq))
+	{
+		return 0;
+	}
+	for(d = 0; d < 8; d++)
+	{
+		line = 0;
+		c = sq % 8 + dc[d];
+		r = sq / 8 + dr[d];
+		while(c >= 0 && c < 8 && r >= 0 && r < 8 && (opp & BIT_ULL(8 * r + c)))
+		{
+			line |= BIT_ULL(8 * r + c);
+			c += dc[d];
+			r += dr[d];
+		}
+		if(c < 0 || c > 7 || r < 0 || r > 7 || !(own & BIT_ULL(8 * r + c)))
+		{
+			continue;
+		}
+		flips |= line;
+	}
+	return flips;
+}
+
+static u64 perft(u64 own, u64 opp, int depth, bool passed)
+{
+	u64 moves, flips, n = 0;
+	int sq;
+	if(depth == 0)
+	{
+		return 1;
+	}
+	moves = bb_moves(own, opp);
+	if(moves == 0)
+	{
+		return passed ? 1 : perft(opp, own, depth - 1, true);
+	}
+	while(moves != 0)
+	{
+		sq = __ffs64(moves);
+		moves &= moves - 1;
+		flips = bb_flips(own, opp, sq);
+		n += perft(opp & ~flips, own | flips | BIT_ULL(sq), depth - 1, false);
+	}
+	return n;
+}
+
+static int final_score(u64 own, u64 opp)
+{	/* disc difference of a finished game, the winner gets the empties */
+	int diff = (int)hweight64(own) - (int)hweight64(opp);
+	int empties = 64 - hweight64(own | opp);
+	if(diff == 0)
+	{
+		return 0;
+	}
+	return diff > 0 ? diff + empties : diff - empties;
+}
+
+static int minimax(u64 own, u64 opp, bool passed)
+{	/* exact final disc difference, the slow way */
+	u64 moves = bb_moves(own, opp), flips;
+	int sq, score, best = -65;
+	if(moves == 0)
+	{
+		return passed ? final_score(own, opp) : -minimax(opp, own, true);
+	}
+	while(moves != 0)
+	{
+		sq = __ffs64(moves);
+		moves &= moves - 1;
+		flips = bb_flips(own, opp, sq);
+		score = -minimax(opp & ~flips, own | flips | BIT_ULL(sq), false);
+		best = max(best, score);
+	}
+	return best;
+}
+
+static void reversi_test_start_moves(struct kunit *test)
+{	/* X's four opening moves, the squares around O's discs */
+	KUNIT_EXPECT_EQ(test, bb_moves(BB_START_X, BB_START_O),
+			BB_SQ(3, 2) | BB_SQ(2, 3) | BB_SQ(5, 4) | BB_SQ(4, 5));
+	KUNIT_EXPECT_EQ(test, bb_flips(BB_START_X, BB_START_O, 8 * 2 + 3),
+			BB_SQ(3, 3));
+	/* taken squares and squares next to nothing flip nothing */
+	KUNIT_EXPECT_EQ(test, bb_flips(BB_START_X, BB_START_O, 8 * 3 + 3), 0ULL);
+	KUNIT_EXPECT_EQ(test, bb_flips(BB_START_X, BB_START_O, 0), 0ULL);
+}
+
+static void reversi_test_diagonal_wrap(struct kunit *test)
+{	/* the old diagonal checks used && where || was meant, so a line could
+	   run off one side of the board and carry on from the other */
+	/* (7, 1) down right would wrap to (0, 3) */
+	KUNIT_EXPECT_EQ(test, bb_flips(BB_SQ(1, 4), BB_SQ(0, 3), 8 * 1 + 7), 0ULL);
+	/* (0, 3) up left would wrap to (7, 1) */
+	KUNIT_EXPECT_EQ(test, bb_flips(BB_SQ(6, 0), BB_SQ(7, 1), 8 * 3 + 0), 0ULL);
+	/* (0, 4) down left would wrap to (7, 4) */
+	KUNIT_EXPECT_EQ(test, bb_flips(BB_SQ(6, 5), BB_SQ(7, 4), 8 * 4 + 0), 0ULL);
+	/* and (0, 2) straight left to (7, 1) */
+	KUNIT_EXPECT_EQ(test, bb_flips(BB_SQ(6, 1), BB_SQ(7, 1), 8 * 2 + 0), 0ULL);
+	/* (7, 5) up right would wrap to (0, 5) */
+	KUNIT_EXPECT_EQ(test, bb_flips(BB_SQ(1, 4), BB_SQ(0, 5), 8 * 5 + 7), 0ULL);
+	/* a real diagonal into the corner still works */
+	KUNIT_EXPECT_EQ(test, bb_flips(BB_SQ(7, 7), BB_SQ(6, 6), 8 * 5 + 5),
+			BB_SQ(6, 6));
+	KUNIT_EXPECT_EQ(test, bb_moves(BB_SQ(1, 4), BB_SQ(0, 3)) & BB_SQ(7, 1), 0ULL);
+}
+
+static void reversi_test_edge_rows(struct kunit *test)
+{	/* the old flip_pieces read board[8 * (row - 1) + col] before checking
+	   row, which left the board on the top and bottom rows */
+	u64 col0 = 0x0101010101010101ULL;
+	/* a column of O all the way up with no X to cap it */
+	KUNIT_EXPECT_EQ(test, bb_flips(0, col0 & ~BIT_ULL(56), 56), 0ULL);
+	/* capped at the top, all six in between flip */
+	KUNIT_EXPECT_EQ(test, bb_flips(BIT_ULL(0), col0 & ~BIT_ULL(0) & ~BIT_ULL(56), 56),
+			col0 & ~BIT_ULL(0) & ~BIT_ULL(56));
+	/* a run along the top row that ends at the edge */
+	KUNIT_EXPECT_EQ(test, bb_flips(0, 0xfeULL, 0), 0ULL);
+	/* and along the bottom row */
+	KUNIT_EXPECT_EQ(test, bb_flips(0, 0x7fULL << 56, 63), 0ULL);
+	KUNIT_EXPECT_EQ(test, bb_flips(BIT_ULL(56), 0x7eULL << 56, 63), 0x7eULL << 56);
+}
+
+static void reversi_test_corpus(struct kunit *test)
+{	/* every square of every corpus position, both sides, against ref_flips */
+	int i, sq, bad = 0;
+	u64 moves, refMoves;
+	for(i = 0; i < CORPUS_SIZE; i++)
+	{
+		refMoves = 0;
+		for(sq = 0; sq < 64; sq++)
+		{
+			if(bb_flips(corpus[i].own, corpus[i].opp, sq) !=
+			   ref_flips(corpus[i].own, corpus[i].opp, sq) ||
+			   bb_flips(corpus[i].opp, corpus[i].own, sq) !=
+			   ref_flips(corpus[i].opp, corpus[i].own, sq))
+			{
+				bad++;
+			}
+			if(ref_flips(corpus[i].own, corpus[i].opp, sq))
+			{
+				refMoves |= BIT_ULL(sq);
+			}
+		}
+		moves = bb_moves(corpus[i].own, corpus[i].opp);
+		KUNIT_EXPECT_EQ(test, moves, refMoves);
+	}
+	KUNIT_EXPECT_EQ(test, bad, 0);
+}
+
+static void reversi_test_perft(struct kunit *test)
+{
+	static const u64 ref[] = { 1, 4, 12, 56, 244, 1396, 8200, 55092 };
+	int d;
+	for(d = 0; d < (int)ARRAY_SIZE(ref); d++)
+	{
+		KUNIT_EXPECT_EQ(test, perft(BB_START_X, BB_START_O, d, false), ref[d]);
+	}
+}
+
+static void reversi_test_solver(struct kunit *test)
+{	/* solve_root against minimax on the corpus positions with 8 or fewer
+	   empties, both the score and that the move it picks gets there */
+	struct search_ctx ctx;
+	int i, sq, score, checked = 0;
+	u64 own, opp, flips;
+	for(i = 0; i < CORPUS_SIZE; i++)
+	{
+		own = corpus[i].own;
+		opp = corpus[i].opp;
+		if(64 - hweight64(own | opp) > 8)
+		{
+			continue;
+		}
+		memset(&ctx, 0, sizeof(ctx));
+		score = solve_root(&ctx, own, opp, &sq);
+		KUNIT_EXPECT_EQ(test, score, minimax(own, opp, false));
+		if(sq >= 0)
+		{
+			flips = bb_flips(own, opp, sq);
+			KUNIT_EXPECT_EQ(test, score,
+					-minimax(opp & ~flips, own | flips | BIT_ULL(sq), false));
+		}
+		checked++;
+	}
+	KUNIT_EXPECT_GT(test, checked, 0);
+}
+
+static void reversi_bench_movegen(struct kunit *test)
+{	/* legal moves and the flips of each one over the whole corpus. Only
+	   reports, but a big jump between runs is worth a look */
+	u64 start, movesNs, flipsNs, sink = 0, moves, calls = 0;
+	int r, i;
+	start = ktime_get_ns();
+	for(r = 0; r < BENCH_ROUNDS; r++)
+	{
+		for(i = 0; i < CORPUS_SIZE; i++)
+		{
+			sink += bb_moves(corpus[i].own, corpus[i].opp);
+		}
+	}
+	movesNs = ktime_get_ns() - start;
+	start = ktime_get_ns();
+	for(r = 0; r < BENCH_ROUNDS; r++)
+	{
+		for(i = 0; i < CORPUS_SIZE; i++)
+		{
+			moves = bb_moves(corpus[i].own, corpus[i].opp);
+			while(moves != 0)
+			{
+				sink += bb_flips(corpus[i].own, corpus[i].opp, __ffs64(moves));
+				moves &= moves - 1;
+				calls++;
+			}
+		}
+	}
+	flipsNs = ktime_get_ns() - start;
+	kunit_info(test, "bb_moves: %llu ns per position\n",
+		   movesNs / (BENCH_ROUNDS * CORPUS_SIZE));
+	kunit_info(test, "bb_flips: %llu ns per move over %llu moves\n",
+		   calls ? flipsNs / calls : 0, calls);
+	KUNIT_EXPECT_NE(test, sink, 0ULL);
+}
+
+static int reversi_suite_init(struct kunit_suite *suite)
+{	/* random games from a fixed seed, stopped anywhere from the opening
+	   to the last few squares */
+	struct rnd_state rnd;
+	u64 own, opp, moves, flips, t;
+	int i, n, stop, passes;
+	/* the flip tables the corpus needs are already filled in. The engine
+	   is not set up again here, games may be using it, and nothing below
+	   searches with the table anyway */
+	corpus = kvmalloc_array(CORPUS_SIZE, sizeof(*corpus), GFP_KERNEL);
+	if(corpus == NULL)
+	{
+		return -ENOMEM;
+	}
+	prandom_seed_state(&rnd, 421);
+	for(i = 0; i < CORPUS_SIZE; i++)
+	{
+		own = BB_START_X;
+		opp = BB_START_O;
+		stop = prandom_u32_state(&rnd) % 60;
+		for(passes = 0; stop > 0 && passes < 2; stop--)
+		{
+			moves = bb_moves(own, opp);
+			if(moves != 0)
+			{
+				passes = 0;
+				for(n = prandom_u32_state(&rnd) % hweight64(moves); n > 0; n--)
+				{
+					moves &= moves - 1;
+				}
+				flips = bb_flips(own, opp, __ffs64(moves));
+				own |= flips | (moves & -moves);
+				opp &= ~flips;
+			}
+			else
+			{
+				passes++;
+			}
+			t = own;
+			own = opp;
+			opp = t;
+		}
+		corpus[i].own = own;
+		corpus[i].opp = opp;
+	}
+	return 0;
+}
+
+static void reversi_suite_exit(struct kunit_suite *suite)
+{
+	kvfree(corpus);
+}
+
+static struct kunit_case reversi_test_cases[] =
+{
+	KUNIT_CASE(reversi_test_start_moves),
+	KUNIT_CASE(reversi_test_diagonal_wrap),
+	KUNIT_CASE(reversi_test_edge_rows),
+	KUNIT_CASE(reversi_test_corpus),
+	KUNIT_CASE(reversi_test_perft),
+	KUNIT_CASE_SLOW(reversi_test_solver),
+	KUNIT_CASE(reversi_bench_movegen),
+	{}
+};
+
+static struct kunit_suite reversi_test_suite =
+{
+	.name = "reversi",
+	.suite_init = reversi_suite_init,
+	.suite_exit = reversi_suite_exit,
+	.test_cases = reversi_test_cases,
+};
+kunit_test_suite(reversi_test_suite);
@@ -0,0 +1,2330 @@
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/miscdevice.h>
+#include <linux/uaccess.h>
+#include <linux/init.h>
+#include <linux/rwsem.h>
+#include <linux/bitops.h>
+#include <linux/ktime.h>
+#include <linux/ctype.h>
+#include <linux/log2.h>
+#include <linux/atomic.h>
+#include <linux/workqueue.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/kfifo.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/seqlock.h>
+#include <linux/debugfs.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+#include <linux/rhashtable.h>
+#include <linux/kref.h>
+#include <linux/rcupdate.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/jiffies.h>
+#include <linux/percpu_counter.h>
+#include <linux/cpumask.h>
+#ifdef CONFIG_IO_URING
+#include <linux/io_uring/cmd.h>
+#endif
+
+#include "reversi_ioctl.h"
+#include "reversi_engine.h"
+
+#define CREATE_TRACE_POINTS
+#include "reversi_trace.h"
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Dave Benton <dbenton2@umbc.edu>");
+MODULE_DESCRIPTION("Driver for Reversi");
+
+#define BOARD_SIZE	67
+/* Text device_read keeps of responses it has drawn but not handed out
+   yet, enough for a few boards at a time */
+#define RESP_TEXT	256
+/* Longest valid command, "06 " and a 20 digit game id then the newline.
+   Anything longer is kept only as far as this so it can still be answered
+   with INVFMT or UNKCMD */
+#define CMD_MAX	24
+/* the trace header comes first, so it has its own copy of the size */
+static_assert(REVERSI_TRACE_CMD == CMD_MAX);
+/* Commands waiting to run and responses waiting to be read, per file.
+   Both must be powers of two for kfifo */
+#define CMD_QUEUE	64
+#define RESP_QUEUE	128
+/* Most moves '08' lists, and so the most responses one command queues.
+   A position with more legal moves than this only gets the best ones */
+#define ANALYZE_MAX	32
+/* Longest idle_timeout taken as it is, a week. Longer ones are cut down
+   to this so the timeout in jiffies stays well inside time_before */
+#define IDLE_TIMEOUT_MAX	(7 * 24 * 60 * 60)
+
+static atomic_t numberOpens = ATOMIC_INIT(0); /* counts number of times module was opened*/
+/* How deep the CPU searches when '00' does not pick a depth */
+static int search_depth = 4;
+module_param(search_depth, int, 0644);
+MODULE_PARM_DESC(search_depth, "Default CPU search depth in plies (1-12)");
+/* Once this few squares are empty the CPU solves the game exactly */
+static int endgame_empties = 12;
+module_param(endgame_empties, int, 0644);
+MODULE_PARM_DESC(endgame_empties, "Empty squares left when the CPU switches to an exact solve (0-16)");
+/* Limits on games held in kernel memory, 0 for no limit. Making a game
+   past either one evicts table games, least recently used first */
+static unsigned int max_games = 65536;
+module_param(max_games, uint, 0644);
+MODULE_PARM_DESC(max_games, "Most games that can exist at once (0 for no limit)");
+static unsigned long max_bytes = 64UL << 20;
+module_param(max_bytes, ulong, 0644);
+MODULE_PARM_DESC(max_bytes, "Most memory games and their mmap pages can use (0 for no limit)");
+/* Table games nobody has written to for this long are evicted */
+static unsigned int idle_timeout = 600;
+module_param(idle_timeout, uint, 0644);
+MODULE_PARM_DESC(idle_timeout, "Seconds before an unused game from '05' is evicted (0 to keep them, at most a week)");
+/* Size of the transposition table, only read once at reversi_init */
+static int tt_mb = 16;
+module_param(tt_mb, int, 0444);
+MODULE_PARM_DESC(tt_mb, "Transposition table size in MiB (0 disables it)");
+/* Used just to make comparisons a little simpler*/
+char X = 'X';
+char O = 'O';
+
+/* The board is kept as two 64-bit masks, one per piece. Square (col, row)
+   is bit 8 * row + col, the same index the text board has always used, so
+   the '01' board is just a walk over the bits when someone asks for it */
+#define PIECE_IDX(p)	((p) == 'X' ? 0 : 1)
+/* Start time for an exit tracepoint's duration, only read when it is on */
+#define TRACE_START(event)	(trace_##event##_enabled() ? ktime_get_ns() : 0)
+
+/* Every search's table counters added up, see tt_stats */
+static atomic64_t ttProbes, ttHits, ttStores;
+/* CPU searches run here so '03' never blocks the writer or the readers */
+static struct workqueue_struct *reversiWq;
+
+/* Counters behind the debugfs files. Every CPU bumps its own copy and
+   reading a file adds them up, so counting costs no shared cachelines */
+#define STAT_CMD_OTHER	9 /* cmds[0] to cmds[8] are '00' to '08' */
+#define STAT_RESP_BOARD	(REVERSI_UNKCMD + 1) /* resps[] is by REVERSI_* */
+#define STAT_RESP_GAME	(STAT_RESP_BOARD + 1) /* the 'GAME <id>' from '05' */
+#define STAT_RESP_REPLY	(STAT_RESP_GAME + 1) /* the CPU's answer, see auto_reply */
+#define STAT_RESP_MOVES	(STAT_RESP_REPLY + 1) /* the move mask from '07' */
+#define STAT_RESP_ANALYSIS	(STAT_RESP_MOVES + 1) /* the move list from '08' */
+#define STAT_RESP_COUNT	(STAT_RESP_ANALYSIS + 1)
+/* A queued response, code is one of the resps[] indexes above. Nothing
+   is turned into text until device_read, see render_resp */
+struct reversi_resp
+{
+	/* the board for STAT_RESP_BOARD, x is the id for STAT_RESP_GAME,
+	   the legal moves for STAT_RESP_MOVES and the score of sq for
+	   STAT_RESP_ANALYSIS, where toMove is what comes after it */
+	u64 x;
+	u64 o;
+	u8 code;
+	char toMove;
+	/* REVERSI_* after the CPU's move and the square it played, -1 for a
+	   pass, for STAT_RESP_REPLY */
+	u8 status;
+	s8 sq;
+};
+#define HIST_BUCKETS	32 /* bucket n counts times of 2^n to 2^(n+1) ns */
+enum
+{
+	HIST_CPU_MOVE, /* CPU search */
+	HIST_VALID_MOVE, /* one valid_move scan */
+	HIST_LOCK_WAIT, /* waiting for a game's lock */
+	HIST_LOCK_HOLD, /* holding it */
+	HIST_COUNT
+};
+static const char *const histNames[HIST_COUNT] =
+{
+	"cpu_move", "valid_move", "lock_wait", "lock_hold",
+};
+struct reversi_stats
+{
+	u64 cmds[STAT_CMD_OTHER + 1];
+	u64 resps[STAT_RESP_COUNT];
+	u64 hist[HIST_COUNT][HIST_BUCKETS];
+};
+static DEFINE_PER_CPU(struct reversi_stats, reversiStats);
+static struct dentry *reversiDebugfs;
+
+/* Text sent back for each REVERSI_* result */
+static const char *const respText[] =
+{
+	[REVERSI_OK] = "OK\n",
+	[REVERSI_ILLMOVE] = "ILLMOVE\n",
+	[REVERSI_OOT] = "OOT\n",
+	[REVERSI_NOGAME] = "NOGAME\n",
+	[REVERSI_WIN] = "WIN\n",
+	[REVERSI_LOSE] = "LOSE\n",
+	[REVERSI_TIE] = "TIE\n",
+	[REVERSI_INVFMT] = "INVFMT\n",
+	[REVERSI_UNKCMD] = "UNKCMD\n",
+};
+/* debugfs names for the responses past REVERSI_UNKCMD */
+static const char *const respNames[] =
+{
+	[STAT_RESP_BOARD - STAT_RESP_BOARD] = "BOARD",
+	[STAT_RESP_GAME - STAT_RESP_BOARD] = "GAME",
+	[STAT_RESP_REPLY - STAT_RESP_BOARD] = "REPLY",
+	[STAT_RESP_MOVES - STAT_RESP_BOARD] = "MOVES",
+	[STAT_RESP_ANALYSIS - STAT_RESP_BOARD] = "ANALYSIS",
+};
+
+/* What cpu_search found, cpu_play makes the move */
+struct cpu_result
+{
+	int sq; /* -1 when the CPU has to pass */
+	int score;
+	bool solved;
+	u64 nodes;
+	u64 ns;
+};
+
+/* What an ioctl reads and writes, device_ioctl and device_uring_cmd
+   copy it in and out their own ways and run_ioctl does the rest */
+union reversi_ioc_arg
+{
+	struct reversi_game_id game;
+	struct reversi_new_game newGame;
+	struct reversi_move move;
+	struct reversi_cpu_move cpu;
+	struct reversi_pass pass;
+	struct reversi_board board;
+	struct reversi_moves moves;
+};
+
+/* One command line out of a write, len is the real length of the line
+   (capped at 255) even when only the first CMD_MAX bytes are kept */
+struct reversi_cmd
+{
+	u8 len;
+	char text[CMD_MAX];
+};
+
+/* Holds everything about one game. Every open file starts out with a
+   game of its own, and '05' makes more that live in a game_shard where
+   any open file can pick them up with '06'. Allocated from gameCache, the
+   locks and such are set up once by game_ctor and everything else by
+   game_alloc */
+struct reversi_game
+{
+	/* Everything a move reads or writes comes first and fits in one
+	   64 byte line, gameCache lines objects up on cachelines. The rest
+	   is only touched to find, lock or free the game */
+	/* disc[0] holds X's pieces and disc[1] holds O's, see PIECE_IDX */
+	u64 disc[2];
+	/* Zobrist hash of disc[] and the side to move, kept up to date */
+	u64 hash;
+	/* Legal moves for each side, indexed like disc[]. Redone whenever
+	   disc[] changes so the end of the game is just both being empty */
+	u64 moves[2];
+	/* Used to hold which pieces the user picks and which the CPU gets */
+	char userPiece;
+	char comPiece;
+	/* Used to determine if it's the CPU or the user's turn*/
+	bool userMove;
+	/* REVERSI_OK while a game is going, NOGAME before the first one and
+	   WIN, LOSE or TIE once it has ended */
+	u8 status;
+	/* How many plies the CPU looks ahead in this game */
+	u8 depth;
+	/* True while a CPU search for this game runs without the lock. No
+	   file may start a new game or another search on it until then */
+	bool searching;
+	/* Started with '00 X A', the CPU answers each move by itself */
+	bool autoReply;
+	/* Plies played in this game, passes included */
+	u16 moveNumber;
+	/* Discs on the board for each side, indexed like disc[] */
+	u8 count[2];
+
+	/* Protects everything in the game */
+	struct rw_semaphore lock;
+	/* Lets GET_BOARD and GET_MOVES read pub without the lock. Its own
+	   spinlock, readers retry under rcu_read_lock and must never sleep */
+	seqlock_t pubLock;
+	/* Tells games apart in traces and is the key in its shard's table,
+	   never reused. The low shardBits are the shard */
+	u64 id;
+	struct rhash_head node;
+	/* One for each file using it and one for the table if it is in it.
+	   The last one frees it after an RCU grace period, so a lookup under
+	   rcu_read_lock can still take a reference with kref_get_unless_zero */
+	struct kref ref;
+	union
+	{
+		/* Place in its shard's lru, empty once it is out of the table */
+		struct list_head lru;
+		/* Only used after the last reference, long off the lru */
+		struct rcu_head rcu;
+	};
+	/* jiffies when a file last wrote to the game, for the reaper */
+	unsigned long lastUsed;
+	/* Copy of the board for GET_BOARD and GET_MOVES, rewritten by
+	   publish_board along with the mmap page */
+	struct reversi_board pub;
+	/* When the lock was last taken for writing, for the lock_hold
+	   histogram */
+	u64 lockedAt;
+	/* Page handed out by mmap, NULL until the first one. Written only
+	   with the lock held for writing, see publish_board */
+	struct reversi_shared *shared;
+};
+static_assert(offsetofend(struct reversi_game, count) <= 64);
+
+/* One of these per open file, hung off file->private_data. It has the
+   command and response queues and the game they currently go to */
+struct reversi_session
+{
+	/* Held while commands run, so they run one at a time and in order.
+	   Taken before the game's lock, never after it */
+	struct mutex lock;
+	/* Only changes with lock held and nothing searching, readers that
+	   do not hold it go through session_get_game */
+	struct reversi_game __rcu *game;
+	/* Commands written but not run yet. They run in order, so anything
+	   after a '03' waits for the CPU's move */
+	DECLARE_KFIFO(cmds, struct reversi_cmd, CMD_QUEUE);
+	/* Responses waiting to be read back to the driver program, in the
+	   order their commands ran */
+	DECLARE_KFIFO(resps, struct reversi_resp, RESP_QUEUE);
+	/* Responses device_read has already taken off resps and drawn, but
+	   that did not fit in the last read. Under readLock */
+	char text[RESP_TEXT];
+	unsigned int textOff;
+	unsigned int textLen;
+	/* True while cpu_work is searching for this file. Later commands
+	   stay queued until it is done */
+	bool searching;
+	/* Depth of the '08' cpu_work is running, 0 when it is a '03' */
+	u8 analyzeDepth;
+	/* What that '08' scored and the responses made from it. Here and not
+	   on the stack, which the search underneath already goes deep into */
+	struct move_score scores[64];
+	struct reversi_resp analysis[ANALYZE_MAX];
+	struct work_struct cpuWork;
+	/* Woken whenever commands run or responses are read */
+	wait_queue_head_t wq;
+	/* resps only ever has one writer, run_command under lock, so readers
+	   just take turns with each other and leave that lock alone */
+	struct mutex readLock;
+	/* Set when commands wait for room in resps. A read that makes room
+	   queues cmdWork to run them instead of taking the lock itself */
+	bool respStall;
+	struct work_struct cmdWork;
+};
+
+/* Games are split up by the CPU that made them, so making, finding and
+   evicting games on different CPUs share no locks or counters. A game's
+   id says which shard it is in, see game_shard */
+struct game_shard
+{
+	/* Games made here with '05', found by id from any open file without
+	   a lock. The table holds a reference on every game in it */
+	struct rhashtable table;
+	/* Table games, least recently written to first. Taking a game off
+	   this list is what gives the right to drop the table's reference,
+	   so it and table only lose a game together, under lruLock */
+	struct list_head lru;
+	spinlock_t lruLock;
+	/* Last id handed out here, shifted up past the shard bits */
+	atomic64_t ids;
+	/* Table games evicted after idle_timeout and to make room */
+	atomic64_t evictIdle, evictCap;
+};
+static DEFINE_PER_CPU_ALIGNED(struct game_shard, gameShards);
+/* How many low bits of a game id are the CPU it was made on */
+static unsigned int shardBits;
+static const struct rhashtable_params gameParams =
+{
+	.key_len = sizeof(u64),
+	.key_offset = offsetof(struct reversi_game, id),
+	.head_offset = offsetof(struct reversi_game, node),
+	.automatic_shrinking = true,
+};
+/* Every game comes out of here, see game_ctor */
+static struct kmem_cache *gameCache;
+/* Every game alive and the bytes they hold, slab objects plus mmap
+   pages. Per CPU so checking max_games and max_bytes stays cheap until
+   they are nearly reached */
+static struct percpu_counter liveGames, liveBytes;
+/* Looks for idle games every REAP_PERIOD */
+#define REAP_PERIOD	HZ
+static void	reap_work(struct work_struct *work);
+static DECLARE_DELAYED_WORK(reapWork, reap_work);
+
+/* Function prototypes here */
+static int	device_open(struct inode *, struct file *);
+static int	device_release(struct inode *, struct file *);
+static ssize_t	device_read(struct file *, char *, size_t, loff_t *);
+static ssize_t 	device_write(struct file *, const char *, size_t, loff_t *);
+static __poll_t	device_poll(struct file *, poll_table *);
+static long	device_ioctl(struct file *, unsigned int, unsigned long);
+static long	run_ioctl(struct reversi_session *s, unsigned int cmd,
+			  union reversi_ioc_arg *u, bool nonblock);
+#ifdef CONFIG_IO_URING
+static int	device_uring_cmd(struct io_uring_cmd *ioucmd, unsigned int issue_flags);
+#endif
+static int	device_mmap(struct file *, struct vm_area_struct *);
+static void	run_commands(struct reversi_session *s);
+static void	run_command(struct reversi_session *s, const struct reversi_cmd *c);
+static void	respond(struct reversi_session *s, int status);
+static void	respond_resp(struct reversi_session *s, const struct reversi_resp *r);
+static void	respond_analysis(struct reversi_session *s,
+				 const struct move_score *scores, int n);
+static unsigned int	cmd_resps(const struct reversi_cmd *c);
+static bool	resp_pending(struct reversi_session *s);
+static int	render_resp(const struct reversi_resp *r, char *out);
+static void	game_ctor(void *obj);
+static struct reversi_game *game_alloc(void);
+static struct reversi_game *game_create(void);
+static struct reversi_game *game_find(u64 id);
+static struct game_shard *game_shard(u64 id);
+static void	game_put(struct reversi_game *g);
+static void	game_release(struct kref *ref);
+static void	game_free_rcu(struct rcu_head *rcu);
+static void	game_touch(struct reversi_game *g);
+static bool	game_evict(struct game_shard *sh, struct reversi_game *g);
+static bool	game_make_room(unsigned int cpu);
+static bool	game_fits(void);
+static struct reversi_game *session_game(struct reversi_session *s);
+static struct reversi_game *session_get_game(struct reversi_session *s);
+static void	session_attach(struct reversi_session *s, struct reversi_game *g);
+static void	new_game(struct reversi_game *g, char piece, int depth, bool autoReply);
+static int	place_move(struct reversi_game *g, int col, int row);
+static u64	valid_move(struct reversi_game *g, int sq, char piece);
+static int	cpu_move(struct reversi_session *s, struct reversi_game *g);
+static void	cpu_work(struct work_struct *work);
+static void	cmd_work(struct work_struct *work);
+static void	cpu_search(struct reversi_game *g, struct cpu_result *res, bool locked);
+static void	auto_reply(struct reversi_session *s, struct reversi_game *g, int status);
+static bool	cpu_reply(struct reversi_game *g, int *status, int *sq);
+static int	cpu_play(struct reversi_game *g, const struct cpu_result *res);
+static int	cpu_analyze(struct reversi_game *g, int depth, struct move_score *scores);
+static void	flip_pieces(struct reversi_game *g, int sq, char piece, u64 flips);
+static int	user_pass(struct reversi_game *g);
+static int	check_winner(struct reversi_game *g);
+static void	publish_board(struct reversi_game *g, int status);
+static void	set_board(struct reversi_game *g, u64 x, u64 o);
+static char	game_to_move(struct reversi_game *g);
+static void	render_board(u64 x, u64 o, char toMove, char *out);
+static int	tt_stats_get(char *buffer, const struct kernel_param *kp);
+static void	game_lock(struct reversi_game *g);
+static bool	game_trylock(struct reversi_game *g);
+static void	game_unlock(struct reversi_game *g);
+static void	stat_time(int hist, u64 ns);
+static int	stats_commands_show(struct seq_file *m, void *v);
+static int	stats_responses_show(struct seq_file *m, void *v);
+static int	stats_histograms_show(struct seq_file *m, void *v);
+static int	stats_games_show(struct seq_file *m, void *v);
+
+/* Struct for file operations for the device */
+const struct file_operations fops = 
+{
+	.owner = THIS_MODULE,
+	.open = device_open,
+	.read = device_read,
+	.write = device_write,
+	.poll = device_poll,
+	.unlocked_ioctl = device_ioctl,
+	.compat_ioctl = compat_ptr_ioctl,
+#ifdef CONFIG_IO_URING
+	.uring_cmd = device_uring_cmd,
+#endif
+	.mmap = device_mmap,
+	.release = device_release
+};
+
+/* Creates a struct for the device */
+struct miscdevice reversiMisc =
+{
+	.minor = MISC_DYNAMIC_MINOR,
+	.name = "reversi",
+	.fops = &fops,
+	.mode = 0666,
+};
+
+
+/* Read only parameter showing how well the transposition table is doing */
+static const struct kernel_param_ops ttStatsOps =
+{
+	.get = tt_stats_get,
+};
+module_param_cb(tt_stats, &ttStatsOps, NULL, 0444);
+MODULE_PARM_DESC(tt_stats, "Transposition table probes, hits and stores");
+
+DEFINE_SHOW_ATTRIBUTE(stats_commands);
+DEFINE_SHOW_ATTRIBUTE(stats_responses);
+DEFINE_SHOW_ATTRIBUTE(stats_histograms);
+DEFINE_SHOW_ATTRIBUTE(stats_games);
+
+
+/* initialization function */
+static int __init reversi_init(void)
+{
+	struct game_shard *sh;
+	unsigned int cpu, other;
+	int err;
+	/* sets up the engine and the transposition table once, every game
+	   shares it */
+	err = engine_init(tt_mb);
+	if(err != 0)
+	{
+		printk(KERN_ALERT "reversi failed to allocate a %d MiB table\n", tt_mb);
+		return err;
+	}
+	/* unbound so long searches spread over every CPU */
+	reversiWq = alloc_workqueue("reversi", WQ_UNBOUND, 0);
+	if(reversiWq == NULL)
+	{
+		err = -ENOMEM;
+		goto out_engine;
+	}
+	/* charged to whoever makes the game, since anyone can make lots */
+	gameCache = kmem_cache_create("reversi_game", sizeof(struct reversi_game), 0,
+				      SLAB_HWCACHE_ALIGN | SLAB_ACCOUNT, game_ctor);
+	if(gameCache == NULL)
+	{
+		err = -ENOMEM;
+		goto out_wq;
+	}
+	err = percpu_counter_init(&liveGames, 0, GFP_KERNEL);
+	if(err != 0)
+	{
+		goto out_cache;
+	}
+	err = percpu_counter_init(&liveBytes, 0, GFP_KERNEL);
+	if(err != 0)
+	{
+		goto out_games;
+	}
+	/* a shard for every CPU that could ever make a game */
+	shardBits = order_base_2(nr_cpu_ids);
+	for_each_possible_cpu(cpu)
+	{
+		sh = per_cpu_ptr(&gameShards, cpu);
+		err = rhashtable_init(&sh->table, &gameParams);
+		if(err != 0)
+		{
+			goto out_shards;
+		}
+		INIT_LIST_HEAD(&sh->lru);
+		spin_lock_init(&sh->lruLock);
+	}
+	err = misc_register(&reversiMisc); /* registers the device */
+	if(err != 0) /* handles if there is an error when registering */
+	{
+		printk(KERN_ALERT "reversi failed to register a major number\n");
+		goto out_shards;
+	}	
+	/* statistics under /sys/kernel/debug/reversi, the module works
+	   the same without them so errors here are not checked */
+	reversiDebugfs = debugfs_create_dir("reversi", NULL);
+	debugfs_create_atomic_t("opens", 0444, reversiDebugfs, &numberOpens);
+	debugfs_create_file("commands", 0444, reversiDebugfs, NULL,
+			    &stats_commands_fops);
+	debugfs_create_file("responses", 0444, reversiDebugfs, NULL,
+			    &stats_responses_fops);
+	debugfs_create_file("histograms", 0444, reversiDebugfs, NULL,
+			    &stats_histograms_fops);
+	debugfs_create_file("games", 0444, reversiDebugfs, NULL,
+			    &stats_games_fops);
+	queue_delayed_work(reversiWq, &reapWork, REAP_PERIOD);
+	/* Displays to the kernel log that the device was initialized */
+	printk(KERN_NOTICE "Reversi init :)\n");	
+	return 0;
+
+out_shards:
+	for_each_possible_cpu(other) /* only the ones before cpu got a table */
+	{
+		if(other == cpu)
+		{
+			break;
+		}
+		rhashtable_destroy(&per_cpu_ptr(&gameShards, other)->table);
+	}
+	percpu_counter_destroy(&liveBytes);
+out_games:
+	percpu_counter_destroy(&liveGames);
+out_cache:
+	kmem_cache_destroy(gameCache);
+out_wq:
+	destroy_workqueue(reversiWq);
+out_engine:
+	engine_exit();
+	return err;
+}
+
+/* Exit function for the device */
+static void __exit reversi_exit(void)
+{
+	struct game_shard *sh;
+	unsigned int cpu;
+	debugfs_remove_recursive(reversiDebugfs);
+	misc_deregister(&reversiMisc); /* Deregisters the device */
+	cancel_delayed_work_sync(&reapWork);
+	destroy_workqueue(reversiWq);
+	/* every file is closed, so only the tables hold games now */
+	for_each_possible_cpu(cpu)
+	{
+		sh = per_cpu_ptr(&gameShards, cpu);
+		spin_lock(&sh->lruLock);
+		while(!list_empty(&sh->lru))
+		{
+			game_evict(sh, list_first_entry(&sh->lru, struct reversi_game, lru));
+		}
+		spin_unlock(&sh->lruLock);
+		rhashtable_destroy(&sh->table);
+	}
+	rcu_barrier(); /* waits for game_free_rcu on all of them */
+	percpu_counter_destroy(&liveBytes);
+	percpu_counter_destroy(&liveGames);
+	kmem_cache_destroy(gameCache);
+	engine_exit(); /* no games are left to use the table */
+	/* Displays to the kernel log that the device has been exited */
+	printk(KERN_NOTICE "Reversi exit :(\n");
+}
+
+
+static int device_open(struct inode *inode, struct file *file)
+{
+	struct reversi_session *s;
+	struct reversi_game *g;
+	/* every open file gets its own queues and a game of its own to start
+	   with, both let go of again in device_release */
+	s = kzalloc(sizeof(*s), GFP_KERNEL);
+	if(s == NULL)
+	{
+		return -ENOMEM;
+	}
+	g = game_alloc();
+	if(IS_ERR(g))
+	{
+		kfree(s);
+		return PTR_ERR(g);
+	}
+	mutex_init(&s->lock);
+	RCU_INIT_POINTER(s->game, g);
+	init_waitqueue_head(&s->wq);
+	INIT_WORK(&s->cpuWork, cpu_work);
+	INIT_WORK(&s->cmdWork, cmd_work);
+	mutex_init(&s->readLock);
+	INIT_KFIFO(s->cmds);
+	INIT_KFIFO(s->resps);
+	file->private_data = s;
+
+	/* Displays to the kernel log how many times the device has been opened */
+	printk(KERN_INFO "reversi: Device has been opened %d time(s)\n",
+	       atomic_inc_return(&numberOpens));
+	return 0;
+}
+
+
+static ssize_t device_read(struct file *filep, char *buffer, size_t len, loff_t *offset)
+{
+	struct reversi_session *s = filep->private_data;
+	struct reversi_resp r;
+	size_t copied = 0, n;
+	int ret = 0;
+	/* while commands are still queued their answers are still to come */
+	while(!resp_pending(s) &&
+	      (!kfifo_is_empty(&s->cmds) || READ_ONCE(s->searching)))
+	{
+		if(filep->f_flags & O_NONBLOCK)
+		{
+			return -EAGAIN;
+		}
+		if(wait_event_interruptible(s->wq, resp_pending(s) ||
+					    (kfifo_is_empty(&s->cmds) && !READ_ONCE(s->searching))))
+		{
+			return -ERESTARTSYS;
+		}
+	}
+	/* the session lock is not needed, kfifo is safe with one reader and
+	   one writer and readLock makes sure there is only one reader */
+	if(mutex_lock_interruptible(&s->readLock))
+	{
+		return -ERESTARTSYS;
+	}
+	/* copies as many queued responses as fit, 0 if everything was read.
+	   They only become text here, a few at a time into s->text */
+	while(copied < len)
+	{
+		if(s->textOff == s->textLen)
+		{
+			n = 0;
+			while(n + BOARD_SIZE <= RESP_TEXT && kfifo_get(&s->resps, &r))
+			{
+				n += render_resp(&r, s->text + n);
+			}
+			WRITE_ONCE(s->textOff, 0);
+			WRITE_ONCE(s->textLen, n);
+			if(n == 0)
+			{
+				break;
+			}
+		}
+		n = min(len - copied, (size_t)(s->textLen - s->textOff));
+		if(copy_to_user(buffer + copied, s->text + s->textOff, n) != 0)
+		{
+			ret = -EFAULT; /* the text stays for the next read */
+			break;
+		}
+		WRITE_ONCE(s->textOff, s->textOff + n);
+		copied += n;
+	}
+	mutex_unlock(&s->readLock);
+	/* commands can be held up by a full response queue, now there is
+	   room. Pairs with the barrier in run_commands */
+	smp_mb();
+	if(READ_ONCE(s->respStall))
+	{
+		queue_work(reversiWq, &s->cmdWork);
+	}
+	wake_up_interruptible(&s->wq);
+	return copied > 0 ? copied : ret;
+}
+
+
+static ssize_t device_write(struct file *filep, const char *buffer, size_t len, loff_t *offset)
+{
+	/* initializes variables before locking */
+	struct reversi_session *s = filep->private_data;
+	struct reversi_cmd c = { 0 };
+	char chunk[64];
+	size_t pos, done, n, i;
+	/* locks the write critical region, only this file is affected. The
+	   game itself is only locked while commands run on it */
+	mutex_lock(&s->lock);
+	game_touch(session_game(s));
+	/* splits the write into lines and queues each one as a command. The
+	   end of the write ends a command too, so a single command without a
+	   newline is answered the way it always was */
+	for(;;)
+	{
+		done = 0;
+		for(pos = 0; pos < len; pos += n)
+		{
+			n = min(len - pos, sizeof(chunk));
+			/* copies from the user buffer to the module */
+			if(copy_from_user(chunk, buffer + pos, n) != 0)
+			{
+				run_commands(s);
+				mutex_unlock(&s->lock);
+				return done > 0 ? done : -EFAULT;
+			}
+			for(i = 0; i < n; i++)
+			{
+				if(c.len < CMD_MAX)
+				{
+					c.text[c.len] = chunk[i];
+				}
+				if(c.len < 255)
+				{
+					c.len++;
+				}
+				if(chunk[i] != '\n' && pos + i + 1 < len)
+				{
+					continue;
+				}
+				/* a whole command, runs what it can if the queue is full */
+				if(kfifo_is_full(&s->cmds))
+				{
+					run_commands(s);
+				}
+				if(!kfifo_put(&s->cmds, c))
+				{
+					goto full;
+				}
+				done = pos + i + 1;
+				memset(&c, 0, sizeof(c));
+			}
+		}
+		break;
+full:
+		/* part of the batch went in, the caller writes the rest later */
+		if(done > 0)
+		{
+			break;
+		}
+		mutex_unlock(&s->lock);
+		if(filep->f_flags & O_NONBLOCK)
+		{
+			return -EAGAIN;
+		}
+		if(wait_event_interruptible(s->wq, !kfifo_is_full(&s->cmds)))
+		{
+			return -ERESTARTSYS;
+		}
+		mutex_lock(&s->lock);
+		memset(&c, 0, sizeof(c));
+	}
+	run_commands(s);
+	/* unlocks the write before returning */
+	mutex_unlock(&s->lock);
+	wake_up_interruptible(&s->wq);
+	return done;
+}
+
+
+static __poll_t device_poll(struct file *filep, poll_table *wait)
+{	/* readable once there is an unread response, writable while there is
+	   room to queue another command */
+	struct reversi_session *s = filep->private_data;
+	__poll_t mask = 0;
+	poll_wait(filep, &s->wq, wait);
+	if(resp_pending(s))
+	{
+		mask |= EPOLLIN | EPOLLRDNORM;
+	}
+	if(!kfifo_is_full(&s->cmds))
+	{
+		mask |= EPOLLOUT | EPOLLWRNORM;
+	}
+	return mask;
+}
+
+
+static void run_commands(struct reversi_session *s)
+{	/* runs queued commands in order until one has to wait, either for the
+	   CPU to finish searching or for the reader to make room for its answer.
+	   Called with s->lock held, the game is locked while they run */
+	struct reversi_cmd c;
+	game_lock(session_game(s));
+	for(;;)
+	{
+		WRITE_ONCE(s->respStall, false);
+		/* a command only runs once everything it can answer with fits */
+		while(s->searching == false && kfifo_peek(&s->cmds, &c) &&
+		      kfifo_avail(&s->resps) >= cmd_resps(&c))
+		{
+			kfifo_skip(&s->cmds);
+			run_command(s, &c);
+		}
+		if(s->searching || kfifo_is_empty(&s->cmds))
+		{
+			break;
+		}
+		/* out of room, device_read queues cmdWork once it frees some.
+		   Either it sees respStall or this sees the room it made */
+		WRITE_ONCE(s->respStall, true);
+		smp_mb();
+		if(kfifo_avail(&s->resps) < cmd_resps(&c))
+		{
+			break;
+		}
+	}
+	/* '05' and '06' may have moved s to another game meanwhile */
+	game_unlock(session_game(s));
+}
+
+
+static unsigned int cmd_resps(const struct reversi_cmd *c)
+{	/* how many responses c may queue, '08' is one per move */
+	return c->text[0] == '0' && c->text[1] == '8' ? ANALYZE_MAX : 1;
+}
+
+
+static void cmd_work(struct work_struct *work)
+{	/* runs commands a read made room for */
+	struct reversi_session *s = container_of(work, struct reversi_session, cmdWork);
+	mutex_lock(&s->lock);
+	run_commands(s);
+	mutex_unlock(&s->lock);
+	wake_up_interruptible(&s->wq);
+}
+
+
+static void run_command(struct reversi_session *s, const struct reversi_cmd *c)
+{
+	struct reversi_game *g = session_game(s), *ng;
+	struct reversi_resp r = { 0 };
+	const char *cmd = c->text;
+	size_t len = c->len;
+	char idText[CMD_MAX];
+	bool autoReply;
+	int depth, i;
+	u64 id;
+	trace_reversi_dispatch(g->id, cmd, len);
+	/* counts it by its number, anything else is lumped together */
+	if(cmd[0] == '0' && cmd[1] >= '0' && cmd[1] <= '8')
+	{
+		this_cpu_inc(reversiStats.cmds[cmd[1] - '0']);
+	}
+	else
+	{
+		this_cpu_inc(reversiStats.cmds[STAT_CMD_OTHER]);
+	}
+	/* if user decides to start a game '00 X or O' */
+	if((cmd[0] == '0' && cmd[1] == '0'))
+	{
+		/* the search depth is optional, '00 X\n' or '00 X 6\n', and so
+		   is an 'A' at the end for the CPU to answer every move itself,
+		   '00 X A\n' or '00 X 6 A\n' */
+		depth = clamp(search_depth, 1, SEARCH_MAX_DEPTH);
+		i = 4;
+		if(cmd[i] == ' ' && isdigit(cmd[i + 1]))
+		{
+			depth = cmd[i + 1] - '0';
+			i += 2;
+			if(isdigit(cmd[i]))
+			{
+				depth = 10 * depth + (cmd[i] - '0');
+				i++;
+			}
+		}
+		autoReply = cmd[i] == ' ' && cmd[i + 1] == 'A';
+		if(autoReply)
+		{
+			i += 2;
+		}
+		/* if correctly entered after 02 */
+		if(cmd[2] == ' ' && (cmd[3] == X || cmd[3] == O) && i + 1 == len &&
+		   cmd[i] == '\n' && depth >= 1 && depth <= SEARCH_MAX_DEPTH)
+		{
+			if(g->searching) /* another file's '03' is still thinking */
+			{
+				respond(s, REVERSI_OOT);
+				return;
+			}
+			/* calls new game function, the CPU opens straight away
+			   in an 'A' game where it is X */
+			new_game(g, cmd[3], depth, autoReply);
+			auto_reply(s, g, REVERSI_OK);
+			
+		}
+		else /* if incorrectly entered after 02 */
+		{
+			respond(s, REVERSI_INVFMT);
+		}
+	} /* if user chooses to display the board */
+	else if(cmd[0] == '0' && cmd[1] == '1' && cmd[2] == '\n')
+	{
+		/* queues the board as it is now, read draws it */
+		r.code = STAT_RESP_BOARD;
+		r.x = g->disc[PIECE_IDX(X)];
+		r.o = g->disc[PIECE_IDX(O)];
+		r.toMove = game_to_move(g);
+		respond_resp(s, &r);
+	}
+	else if(cmd[0] == '0' && cmd[1] == '5' && cmd[2] == '\n')
+	{	/* makes a game any file can find by its id and moves this one to it */
+		ng = game_create();
+		if(IS_ERR(ng)) /* out of memory or over the caps */
+		{
+			respond(s, REVERSI_NOGAME);
+			return;
+		}
+		session_attach(s, ng);
+		r.code = STAT_RESP_GAME;
+		r.x = ng->id;
+		respond_resp(s, &r);
+	}
+	else if(cmd[0] == '0' && cmd[1] == '6')
+	{	/* '06 <id>' moves this file to a game made by '05' */
+		if(len > CMD_MAX || len < 5 || cmd[2] != ' ' || cmd[len - 1] != '\n' ||
+		   !isdigit(cmd[3]))
+		{
+			respond(s, REVERSI_INVFMT);
+			return;
+		}
+		memcpy(idText, cmd + 3, len - 3);
+		idText[len - 3] = '\0';
+		if(kstrtou64(idText, 10, &id) != 0)
+		{
+			respond(s, REVERSI_INVFMT);
+			return;
+		}
+		ng = game_find(id);
+		if(ng == NULL) /* never made, or already gone */
+		{
+			respond(s, REVERSI_NOGAME);
+			return;
+		}
+		session_attach(s, ng);
+		respond(s, REVERSI_OK);
+	}
+	else if (g->status == REVERSI_OK) /* if a game currently exists */
+	{		
+		/* if user enters '02' to make a move */
+		if(cmd[0] == '0' && cmd[1] == '2')
+		{
+			/* if command is too long print INVFMT error, and anything
+			   but 0-7 is not a square */
+			if (len > 7 || len < 7 || cmd[2] != ' ' || cmd[4] != ' ' ||
+			    cmd[3] < '0' || cmd[3] > '7' || cmd[5] < '0' || cmd[5] > '7')
+			{
+				respond(s, REVERSI_INVFMT);
+			} /* another file's '03' or '08' is looking at this board */
+			else if(g->searching)
+			{
+				respond(s, REVERSI_OOT);
+			} /* if command is correct */
+			else
+			{
+				/* calls function to place a move */
+				auto_reply(s, g, place_move(g, cmd[3] - '0', cmd[5] - '0'));
+			}
+		} 	/* if user enters '03' for CPU move */
+		else if(cmd[0] == '0' && cmd[1] == '3' && cmd[2] == '\n')
+		{ 	/* calls function to make a CPU move, it answers itself */
+			if(cpu_move(s, g) != REVERSI_OK)
+			{
+				respond(s, REVERSI_OOT);
+			}
+		}
+		else if(cmd[0] == '0' && cmd[1] == '4' && cmd[2] == '\n')
+		{ 	/* calls function for user to pass their move, not while
+			   another file searches the board it would change */
+			if(g->searching)
+			{
+				respond(s, REVERSI_OOT);
+			}
+			else
+			{
+				auto_reply(s, g, user_pass(g));
+			}
+		}
+		else if(cmd[0] == '0' && cmd[1] == '7' && cmd[2] == '\n')
+		{	/* every legal move for whoever is up, so nobody has to
+			   find them by trying '02' on each square */
+			r.code = STAT_RESP_MOVES;
+			r.toMove = game_to_move(g);
+			r.x = g->moves[PIECE_IDX(r.toMove)];
+			respond_resp(s, &r);
+		}
+		else if(cmd[0] == '0' && cmd[1] == '8')
+		{	/* '08' or '08 d' scores every legal move for whoever is up,
+			   d plies deep or the game's depth, best first. Searches
+			   on the workqueue like '03' and answers from cpu_work */
+			depth = g->depth;
+			i = 2;
+			if(cmd[i] == ' ' && isdigit(cmd[i + 1]))
+			{
+				depth = cmd[i + 1] - '0';
+				i += 2;
+				if(isdigit(cmd[i]))
+				{
+					depth = 10 * depth + (cmd[i] - '0');
+					i++;
+				}
+			}
+			if(i + 1 != len || cmd[i] != '\n' || depth < 1 ||
+			   depth > SEARCH_MAX_DEPTH)
+			{
+				respond(s, REVERSI_INVFMT);
+			}
+			else if(g->searching) /* another file is searching this game */
+			{
+				respond(s, REVERSI_OOT);
+			}
+			else
+			{
+				s->analyzeDepth = depth;
+				g->searching = true;
+				s->searching = true;
+				queue_work(reversiWq, &s->cpuWork);
+			}
+		}
+		else
+		{ 	/* anything else, responds with UNKCMD */
+			respond(s, REVERSI_UNKCMD);
+		}
+	}
+	else
+	{ /* respons with NOGAME if a game has not been started or one has ended */
+		respond(s, REVERSI_NOGAME);
+	}
+}
+
+
+static void respond(struct reversi_session *s, int status)
+{	/* queues a plain REVERSI_* response */
+	struct reversi_resp r = { .code = status };
+	respond_resp(s, &r);
+}
+
+
+static void respond_resp(struct reversi_session *s, const struct reversi_resp *r)
+{	/* queues a response for read, run_commands made sure there is room */
+	kfifo_put(&s->resps, *r);
+	this_cpu_inc(reversiStats.resps[r->code]);
+}
+
+
+static void respond_analysis(struct reversi_session *s,
+			     const struct move_score *scores, int n)
+{	/* queues the '08' list as one response per move, all at once so a
+	   read never sees half of it. 'PASS' when there are no moves */
+	struct reversi_resp *r = s->analysis;
+	int i;
+	n = min(n, ANALYZE_MAX);
+	memset(r, 0, sizeof(s->analysis));
+	for(i = 0; i < n; i++)
+	{
+		r[i].code = STAT_RESP_ANALYSIS;
+		r[i].sq = scores[i].sq;
+		r[i].x = (s64)scores[i].score;
+		r[i].toMove = i + 1 < n ? ',' : '\n';
+	}
+	if(n == 0)
+	{
+		r[0].code = STAT_RESP_ANALYSIS;
+		r[0].sq = -1;
+		n = 1;
+	}
+	kfifo_in(&s->resps, r, n);
+	this_cpu_inc(reversiStats.resps[STAT_RESP_ANALYSIS]);
+}
+
+
+static bool resp_pending(struct reversi_session *s)
+{	/* true if a read would get something right now */
+	return !kfifo_is_empty(&s->resps) ||
+		READ_ONCE(s->textOff) != READ_ONCE(s->textLen);
+}
+
+
+static int render_resp(const struct reversi_resp *r, char *out)
+{	/* writes the text of r to out, never more than BOARD_SIZE bytes, and
+	   returns how long it is */
+	switch(r->code)
+	{
+	case STAT_RESP_BOARD:
+		render_board(r->x, r->o, r->toMove, out);
+		return BOARD_SIZE;
+	case STAT_RESP_GAME:
+		return sprintf(out, "GAME %llu\n", r->x);
+	case STAT_RESP_MOVES: /* bit 8 * row + col set for each legal move */
+		return sprintf(out, "%016llx\t%c\n", r->x, r->toMove);
+	case STAT_RESP_ANALYSIS: /* '3 2 -1500,' with the last one ending the line */
+		if(r->sq < 0)
+		{
+			return sprintf(out, "PASS\n");
+		}
+		return sprintf(out, "%d %d %lld%c", r->sq % 8, r->sq / 8,
+			       (s64)r->x, r->toMove);
+	case STAT_RESP_REPLY: /* 'OK 2 4\n' or 'LOSE PASS\n' */
+		if(r->sq < 0)
+		{
+			return sprintf(out, "%.*s PASS\n",
+				       (int)strlen(respText[r->status]) - 1,
+				       respText[r->status]);
+		}
+		return sprintf(out, "%.*s %d %d\n", (int)strlen(respText[r->status]) - 1,
+			       respText[r->status], r->sq % 8, r->sq / 8);
+	default:
+		memcpy(out, respText[r->code], strlen(respText[r->code]));
+		return strlen(respText[r->code]);
+	}
+}
+
+
+static int device_mmap(struct file *filep, struct vm_area_struct *vma)
+{	/* maps the board page of the file's current game read-only, see
+	   struct reversi_shared. The mapping stays with that game even if
+	   the file moves on to another one */
+	struct reversi_session *s = filep->private_data;
+	struct reversi_game *g;
+	unsigned long page;
+	int ret;
+
+	if(vma->vm_pgoff != 0 || vma_pages(vma) != 1)
+	{
+		return -EINVAL;
+	}
+	if(vma->vm_flags & VM_WRITE)
+	{
+		return -EPERM;
+	}
+	vm_flags_clear(vma, VM_MAYWRITE);
+
+	/* not s->lock, device_write holds that while it faults in the
+	   user's buffer and this runs with mmap_lock held */
+	g = session_get_game(s);
+	game_lock(g);
+	if(g->shared == NULL) /* first mapping, fills the page in */
+	{
+		page = get_zeroed_page(GFP_KERNEL);
+		if(page == 0)
+		{
+			game_unlock(g);
+			game_put(g);
+			return -ENOMEM;
+		}
+		g->shared = (struct reversi_shared *)page;
+		percpu_counter_add(&liveBytes, PAGE_SIZE);
+		publish_board(g, g->status);
+	}
+	ret = vm_insert_page(vma, vma->vm_start, virt_to_page(g->shared));
+	game_unlock(g);
+	game_put(g);
+	return ret;
+}
+
+
+static long device_ioctl(struct file *filep, unsigned int cmd, unsigned long arg)
+{	/* binary versions of the text commands, see reversi_ioctl.h */
+	struct reversi_session *s = filep->private_data;
+	void __user *argp = (void __user *)arg;
+	union reversi_ioc_arg u;
+	long ret;
+
+	memset(&u, 0, sizeof(u));
+	switch(cmd)
+	{
+	case REVERSI_IOC_NEW_GAME:
+	case REVERSI_IOC_MOVE:
+	case REVERSI_IOC_ATTACH_GAME:
+		if(copy_from_user(&u, argp, _IOC_SIZE(cmd)))
+		{
+			return -EFAULT;
+		}
+		break;
+	}
+	ret = run_ioctl(s, cmd, &u, false);
+	if(ret == 0 && (_IOC_DIR(cmd) & _IOC_READ) &&
+	   copy_to_user(argp, &u, _IOC_SIZE(cmd)))
+	{
+		return -EFAULT;
+	}
+	return ret;
+}
+
+
+static long run_ioctl(struct reversi_session *s, unsigned int cmd,
+		      union reversi_ioc_arg *u, bool nonblock)
+{	/* runs an ioctl whose argument, if it has one, is already in u and
+	   leaves what it returns there too. With nonblock it gives up with
+	   -EAGAIN instead of waiting for a lock, a search or an allocation */
+	struct reversi_game *g, *ng;
+	struct cpu_result res;
+	unsigned int seq;
+
+	switch(cmd)
+	{
+	case REVERSI_IOC_GET_BOARD:
+	case REVERSI_IOC_GET_MOVES:
+		/* copies the published board, retrying if a move lands meanwhile.
+		   No reference, games are freed through RCU so g stays put until
+		   rcu_read_unlock, and a kref on every read would bounce the
+		   game's cache line between readers */
+		rcu_read_lock();
+		g = rcu_dereference(s->game);
+		do
+		{
+			seq = read_seqbegin(&g->pubLock);
+			u->board = g->pub;
+		} while(read_seqretry(&g->pubLock, seq));
+		rcu_read_unlock();
+		if(cmd == REVERSI_IOC_GET_MOVES)
+		{
+			u->moves.moves = u->board.toMove == REVERSI_X ?
+				bb_moves(u->board.x, u->board.o) :
+				bb_moves(u->board.o, u->board.x);
+			u->moves.toMove = u->board.toMove;
+			u->moves.reserved = 0;
+		}
+		return 0;
+	case REVERSI_IOC_CPU_MOVE:
+	case REVERSI_IOC_CREATE_GAME:
+	case REVERSI_IOC_ATTACH_GAME:
+		/* a whole search, or another game's lock and maybe memory */
+		if(nonblock)
+		{
+			return -EAGAIN;
+		}
+		break;
+	case REVERSI_IOC_NEW_GAME:
+	case REVERSI_IOC_MOVE:
+	case REVERSI_IOC_PASS:
+		break;
+	default:
+		return -ENOTTY;
+	}
+
+	if(nonblock)
+	{
+		if(!mutex_trylock(&s->lock))
+		{
+			return -EAGAIN;
+		}
+		g = session_game(s);
+		if(!game_trylock(g))
+		{
+			mutex_unlock(&s->lock);
+			return -EAGAIN;
+		}
+	}
+	else
+	{
+		mutex_lock(&s->lock);
+		g = session_game(s);
+		game_lock(g);
+	}
+	/* text commands still queued or searching get to finish first, and
+	   so does a search another file started on this game */
+	if(g->searching || !kfifo_is_empty(&s->cmds))
+	{
+		game_unlock(g);
+		mutex_unlock(&s->lock);
+		return -EBUSY;
+	}
+	/* an 'A' game answers a move with a whole search, too long to run
+	   where nonblock callers are */
+	if(nonblock && g->autoReply &&
+	   (cmd == REVERSI_IOC_MOVE || cmd == REVERSI_IOC_PASS))
+	{
+		game_unlock(g);
+		mutex_unlock(&s->lock);
+		return -EAGAIN;
+	}
+	/* games played only through here or io_uring are in use just the
+	   same. session_attach touches the game CREATE and ATTACH move to */
+	game_touch(g);
+	switch(cmd)
+	{
+	case REVERSI_IOC_NEW_GAME:
+		if(u->newGame.piece > REVERSI_O || u->newGame.depth > SEARCH_MAX_DEPTH)
+		{
+			game_unlock(g);
+			mutex_unlock(&s->lock);
+			return -EINVAL;
+		}
+		new_game(g, u->newGame.piece == REVERSI_X ? X : O,
+			 u->newGame.depth ? u->newGame.depth :
+			 clamp(search_depth, 1, SEARCH_MAX_DEPTH), false);
+		break;
+	case REVERSI_IOC_CREATE_GAME:
+	case REVERSI_IOC_ATTACH_GAME:
+		ng = cmd == REVERSI_IOC_CREATE_GAME ? game_create() : game_find(u->game.id);
+		if(IS_ERR_OR_NULL(ng))
+		{
+			game_unlock(g);
+			mutex_unlock(&s->lock);
+			return ng == NULL ? -ENOENT : PTR_ERR(ng);
+		}
+		session_attach(s, ng); /* leaves ng locked instead of g */
+		u->game.id = ng->id;
+		game_unlock(ng);
+		mutex_unlock(&s->lock);
+		return 0;
+	case REVERSI_IOC_MOVE:
+		if(u->move.col > 7 || u->move.row > 7)
+		{
+			game_unlock(g);
+			mutex_unlock(&s->lock);
+			return -EINVAL;
+		}
+		u->move.status = g->status == REVERSI_OK ?
+			place_move(g, u->move.col, u->move.row) : REVERSI_NOGAME;
+		/* answered like '02' is in an 'A' game */
+		u->move.reply = REVERSI_NO_REPLY;
+		cpu_reply(g, &u->move.status, &u->move.reply);
+		break;
+	case REVERSI_IOC_PASS:
+		u->pass.status = g->status == REVERSI_OK ? user_pass(g) : REVERSI_NOGAME;
+		u->pass.reply = REVERSI_NO_REPLY;
+		cpu_reply(g, &u->pass.status, &u->pass.reply);
+		break;
+	case REVERSI_IOC_CPU_MOVE:
+		u->cpu.status = REVERSI_NOGAME;
+		if(g->status != REVERSI_OK)
+		{
+			break;
+		}
+		u->cpu.status = REVERSI_OOT;
+		if(g->userMove == true)
+		{
+			break;
+		}
+		/* same as cpu_work, searches without the locks then plays */
+		g->searching = true;
+		s->searching = true;
+		game_unlock(g);
+		mutex_unlock(&s->lock);
+		cpu_search(g, &res, false);
+		mutex_lock(&s->lock);
+		game_lock(g);
+		u->cpu.status = cpu_play(g, &res);
+		u->cpu.col = res.sq >= 0 ? res.sq % 8 : -1;
+		u->cpu.row = res.sq >= 0 ? res.sq / 8 : -1;
+		u->cpu.score = res.score;
+		u->cpu.solved = res.solved;
+		u->cpu.nodes = res.nodes;
+		u->cpu.ns = res.ns;
+		g->searching = false;
+		game_unlock(g);
+		s->searching = false;
+		/* text commands written meanwhile were held up behind this */
+		run_commands(s);
+		mutex_unlock(&s->lock);
+		wake_up_interruptible(&s->wq);
+		return 0;
+	}
+	game_unlock(g);
+	mutex_unlock(&s->lock);
+	return 0;
+}
+
+
+#ifdef CONFIG_IO_URING
+static int device_uring_cmd(struct io_uring_cmd *ioucmd, unsigned int issue_flags)
+{	/* io_uring passthrough, cmd_op is one of the ioctl numbers and runs
+	   the same thing. The argument comes out of the SQE and the result
+	   goes back in the CQE, see reversi_ioctl.h for which is where */
+	struct reversi_session *s = ioucmd->file->private_data;
+	const void *sqeCmd = io_uring_sqe_cmd(ioucmd->sqe);
+	unsigned int cmd = ioucmd->cmd_op;
+	union reversi_ioc_arg u;
+	u64 res2 = 0;
+	long ret;
+
+	memset(&u, 0, sizeof(u));
+	switch(cmd)
+	{
+	case REVERSI_IOC_NEW_GAME:
+	case REVERSI_IOC_MOVE:
+	case REVERSI_IOC_ATTACH_GAME:
+		/* each fits in the 16 bytes a plain SQE has for a command */
+		memcpy(&u, sqeCmd, _IOC_SIZE(cmd));
+		break;
+	}
+	/* first try is inline from the submitter, -EAGAIN has io_uring try
+	   again from a worker that can wait */
+	ret = run_ioctl(s, cmd, &u, issue_flags & IO_URING_F_NONBLOCK);
+	if(ret != 0)
+	{
+		return ret;
+	}
+	switch(cmd)
+	{
+	case REVERSI_IOC_GET_BOARD:
+		/* too big for a CQE, so it goes where the SQE says */
+		ret = copy_to_user(u64_to_user_ptr(((const struct reversi_uring_board *)sqeCmd)->addr),
+				   &u.board, sizeof(u.board)) ? -EFAULT : 0;
+		break;
+	case REVERSI_IOC_MOVE:
+		ret = u.move.status;
+		res2 = (u64)(s64)u.move.reply;
+		break;
+	case REVERSI_IOC_PASS:
+		ret = u.pass.status;
+		res2 = (u64)(s64)u.pass.reply;
+		break;
+	case REVERSI_IOC_CPU_MOVE:
+		ret = u.cpu.status;
+		res2 = REVERSI_URING_CPU(u.cpu.col, u.cpu.row, u.cpu.score, u.cpu.solved);
+		break;
+	case REVERSI_IOC_GET_MOVES:
+		ret = u.moves.toMove;
+		res2 = u.moves.moves;
+		break;
+	case REVERSI_IOC_CREATE_GAME:
+		res2 = u.game.id;
+		break;
+	}
+	/* res2 only reaches the CQE through here, it is lost on a ring
+	   without IORING_SETUP_CQE32 */
+	io_uring_cmd_done(ioucmd, ret, res2, issue_flags);
+	return -EIOCBQUEUED;
+}
+#endif
+
+static int device_release(struct inode *inodep, struct file *filep)
+{ 	/* device release function, frees this file's queues and lets go of
+	   its game, which goes too unless '05' or another file still has it */
+	struct reversi_session *s = filep->private_data;
+	struct reversi_game *g;
+	/* cmd_work goes first, a '03' it runs can still queue cpuWork */
+	cancel_work_sync(&s->cmdWork);
+	/* nothing else can be using s by now */
+	g = rcu_dereference_protected(s->game, true);
+	/* waits out a search still running. One that never got to start
+	   still has the game marked, which other files would see forever */
+	if(cancel_work_sync(&s->cpuWork))
+	{
+		game_lock(g);
+		g->searching = false;
+		publish_board(g, g->status);
+		game_unlock(g);
+	}
+	game_put(g);
+	kfree(s);
+	filep->private_data = NULL;
+	/* prints to kernel device has been closed */
+	printk(KERN_INFO "reversi: Device closed");
+	return 0;
+}
+
+static void game_ctor(void *obj)
+{	/* runs once per object when gameCache grows, not on every allocation.
+	   The locks are left unlocked by every game that is freed, so they
+	   only ever need setting up here */
+	struct reversi_game *g = obj;
+	init_rwsem(&g->lock);
+	seqlock_init(&g->pubLock);
+}
+
+
+static struct reversi_game *game_alloc(void)
+{	/* a game with nothing started yet, which is how every open file and
+	   every '05' begins. The caller gets the one reference. It goes in
+	   the shard of whatever CPU this runs on, moving off it later on
+	   does no harm */
+	unsigned int cpu = raw_smp_processor_id();
+	struct game_shard *sh = per_cpu_ptr(&gameShards, cpu);
+	struct reversi_game *g;
+	if(!game_make_room(cpu))
+	{
+		return ERR_PTR(-ENOSPC);
+	}
+	g = kmem_cache_alloc(gameCache, GFP_KERNEL);
+	if(g == NULL)
+	{
+		return ERR_PTR(-ENOMEM);
+	}
+	percpu_counter_inc(&liveGames);
+	percpu_counter_add(&liveBytes, kmem_cache_size(gameCache));
+	/* the game itself and everything after the linkage start from zero */
+	memset(g, 0, offsetof(struct reversi_game, lock));
+	memset(&g->pub, 0, sizeof(*g) - offsetof(struct reversi_game, pub));
+	g->id = (u64)atomic64_inc_return(&sh->ids) << shardBits | cpu;
+	kref_init(&g->ref);
+	INIT_LIST_HEAD(&g->lru);
+	g->lastUsed = jiffies;
+	g->status = REVERSI_NOGAME;
+	set_board(g, BB_START_X, BB_START_O);
+	/* what publish_board would write, done by hand since nobody can see
+	   g yet. The caller may hold another game's lock, taking this one
+	   would look like recursion to lockdep */
+	g->pub.x = g->disc[PIECE_IDX(X)];
+	g->pub.o = g->disc[PIECE_IDX(O)];
+	g->pub.toMove = PIECE_IDX(X);
+	g->pub.userPiece = PIECE_IDX(X);
+	return g;
+}
+
+
+static struct reversi_game *game_create(void)
+{	/* a new game in its shard's table, with a reference for the caller
+	   as well as the one the table holds */
+	struct reversi_game *g = game_alloc();
+	struct game_shard *sh;
+	int err;
+	if(IS_ERR(g))
+	{
+		return g;
+	}
+	sh = game_shard(g->id);
+	/* taken first, once it is in the table anyone can find it */
+	kref_get(&g->ref);
+	err = rhashtable_insert_fast(&sh->table, &g->node, gameParams);
+	if(err != 0)
+	{
+		/* nobody else ever saw it */
+		percpu_counter_dec(&liveGames);
+		percpu_counter_sub(&liveBytes, kmem_cache_size(gameCache));
+		kmem_cache_free(gameCache, g);
+		return ERR_PTR(err);
+	}
+	spin_lock(&sh->lruLock);
+	list_add_tail(&g->lru, &sh->lru);
+	spin_unlock(&sh->lruLock);
+	return g;
+}
+
+
+static struct reversi_game *game_find(u64 id)
+{	/* looks id up in its shard without any lock, returns the game with a
+	   reference taken or NULL if there is no such game */
+	struct game_shard *sh = game_shard(id);
+	struct reversi_game *g;
+	if(sh == NULL) /* made up, no CPU of ours has that number */
+	{
+		return NULL;
+	}
+	rcu_read_lock();
+	g = rhashtable_lookup(&sh->table, &id, gameParams);
+	if(g != NULL && !kref_get_unless_zero(&g->ref)) /* on its way out */
+	{
+		g = NULL;
+	}
+	rcu_read_unlock();
+	return g;
+}
+
+
+static struct game_shard *game_shard(u64 id)
+{	/* the shard a game id was handed out by, straight from its low bits.
+	   NULL if the id cannot be one of ours */
+	unsigned int cpu = id & ((1ULL << shardBits) - 1);
+	if(cpu >= nr_cpu_ids || !cpu_possible(cpu))
+	{
+		return NULL;
+	}
+	return per_cpu_ptr(&gameShards, cpu);
+}
+
+
+static void game_put(struct reversi_game *g)
+{
+	kref_put(&g->ref, game_release);
+}
+
+
+static void game_release(struct kref *ref)
+{	/* last reference gone, a game_find may still be looking at it so the
+	   memory only goes back after a grace period */
+	struct reversi_game *g = container_of(ref, struct reversi_game, ref);
+	/* any mapping holds its own reference to the page */
+	if(g->shared != NULL)
+	{
+		free_page((unsigned long)g->shared);
+		percpu_counter_sub(&liveBytes, PAGE_SIZE);
+	}
+	percpu_counter_dec(&liveGames);
+	percpu_counter_sub(&liveBytes, kmem_cache_size(gameCache));
+	call_rcu(&g->rcu, game_free_rcu);
+}
+
+
+static void game_free_rcu(struct rcu_head *rcu)
+{
+	kmem_cache_free(gameCache, container_of(rcu, struct reversi_game, rcu));
+}
+
+
+static void game_touch(struct reversi_game *g)
+{	/* moves g to the recent end of its shard's lru, at most once a jiffy */
+	struct game_shard *sh;
+	unsigned long now = jiffies;
+	if(READ_ONCE(g->lastUsed) == now)
+	{
+		return;
+	}
+	WRITE_ONCE(g->lastUsed, now);
+	sh = game_shard(g->id);
+	spin_lock(&sh->lruLock);
+	if(!list_empty(&g->lru)) /* only table games are on it */
+	{
+		list_move_tail(&g->lru, &sh->lru);
+	}
+	spin_unlock(&sh->lruLock);
+}
+
+
+static bool game_evict(struct game_shard *sh, struct reversi_game *g)
+{	/* takes g out of the table of sh, its shard, and drops the table's
+	   reference, called with sh->lruLock held. Files still on g keep
+	   playing it, it just cannot be found by id any more. True if that
+	   was the last reference and g is gone */
+	list_del_init(&g->lru);
+	rhashtable_remove_fast(&sh->table, &g->node, gameParams);
+	return kref_put(&g->ref, game_release);
+}
+
+
+static bool game_make_room(unsigned int cpu)
+{	/* evicts the least recently used table games until one more game
+	   fits, false if it never does. The shard of cpu, where the game is
+	   going, gives up its games first and the others only once it has
+	   none left, so a busy CPU mostly evicts its own */
+	struct game_shard *sh;
+	struct reversi_game *g, *tmp;
+	unsigned int i, next;
+	bool fits = game_fits();
+	for(i = 0; !fits && i < nr_cpu_ids; ++i)
+	{
+		next = (cpu + i) % nr_cpu_ids;
+		if(!cpu_possible(next))
+		{
+			continue;
+		}
+		sh = per_cpu_ptr(&gameShards, next);
+		spin_lock(&sh->lruLock);
+		list_for_each_entry_safe(g, tmp, &sh->lru, lru)
+		{
+			if(game_fits())
+			{
+				break;
+			}
+			/* a game a file is still on would stay counted and only
+			   become unreachable by id, so it is left alone */
+			if(kref_read(&g->ref) > 1)
+			{
+				continue;
+			}
+			/* a game_find can still take a reference meanwhile, then
+			   nothing was freed and it does not count */
+			if(game_evict(sh, g))
+			{
+				atomic64_inc(&sh->evictCap);
+			}
+		}
+		spin_unlock(&sh->lruLock);
+		fits = game_fits();
+	}
+	return fits;
+}
+
+
+static bool game_fits(void)
+{	/* true if one more game stays under max_games and max_bytes. The
+	   per-CPU counts only get added up when they are close to a cap */
+	unsigned int maxGames = READ_ONCE(max_games);
+	unsigned long maxBytes = READ_ONCE(max_bytes);
+	unsigned int size = kmem_cache_size(gameCache);
+	if(maxGames != 0 && percpu_counter_compare(&liveGames, maxGames) >= 0)
+	{
+		return false;
+	}
+	return maxBytes == 0 || (maxBytes >= size &&
+		percpu_counter_compare(&liveBytes, maxBytes - size) <= 0);
+}
+
+
+static void reap_work(struct work_struct *work)
+{	/* evicts table games idle for longer than idle_timeout. Each lru is
+	   in order of last use, so it stops at the first one still in use */
+	unsigned long timeout = (unsigned long)min_t(unsigned int, READ_ONCE(idle_timeout),
+						     IDLE_TIMEOUT_MAX) * HZ;
+	struct game_shard *sh;
+	struct reversi_game *g;
+	unsigned int cpu;
+	for_each_possible_cpu(cpu)
+	{
+		sh = per_cpu_ptr(&gameShards, cpu);
+		spin_lock(&sh->lruLock);
+		while(timeout != 0 && !list_empty(&sh->lru))
+		{
+			g = list_first_entry(&sh->lru, struct reversi_game, lru);
+			if(time_before(jiffies, READ_ONCE(g->lastUsed) + timeout))
+			{
+				break;
+			}
+			game_evict(sh, g);
+			atomic64_inc(&sh->evictIdle);
+		}
+		spin_unlock(&sh->lruLock);
+	}
+	queue_delayed_work(reversiWq, &reapWork, REAP_PERIOD);
+}
+
+
+static struct reversi_game *session_game(struct reversi_session *s)
+{	/* the game s is on, for whoever holds s->lock or is searching for s.
+	   Neither can see it change */
+	return rcu_dereference_protected(s->game, lockdep_is_held(&s->lock) ||
+					 READ_ONCE(s->searching));
+}
+
+
+static struct reversi_game *session_get_game(struct reversi_session *s)
+{	/* the game s is on with a reference taken, for readers that stay off
+	   s->lock. If an '06' lets go of the old game meanwhile the new one
+	   is already in s->game, so the retry finds that */
+	struct reversi_game *g;
+	rcu_read_lock();
+	do
+	{
+		g = rcu_dereference(s->game);
+	} while(!kref_get_unless_zero(&g->ref));
+	rcu_read_unlock();
+	return g;
+}
+
+
+static void session_attach(struct reversi_session *s, struct reversi_game *g)
+{	/* moves s over to g, taking over the caller's reference on it. Called
+	   with s->lock held and the old game locked, and leaves g locked
+	   instead so run_commands can carry on with it */
+	struct reversi_game *old = session_game(s);
+	game_unlock(old);
+	rcu_assign_pointer(s->game, g);
+	game_touch(g);
+	game_lock(g);
+	game_put(old);
+}
+
+
+static void new_game(struct reversi_game *g, char piece, int depth, bool autoReply)
+{
+	g->userPiece = piece; /* sets user's piece */
+	g->depth = depth; /* sets how far the CPU looks ahead */
+	g->autoReply = autoReply;
+	/* resets the board */
+	set_board(g, BB_START_X, BB_START_O);
+	g->hash = zobrist_hash(BB_START_X, BB_START_O, false);
+	if(piece == X) /* if user selected X, sets CPU's piece and sets user's move */
+	{
+		g->userMove = true;
+		g->comPiece = O;
+	}
+	else /* if user selected ), sets CPU's piece and user's move */
+	{
+		g->userMove = false;
+		g->comPiece = X;
+	}
+	g->status = REVERSI_OK; /* sets game as 'being played' */
+	g->moveNumber = 0;
+	publish_board(g, REVERSI_OK);
+}
+
+static int place_move(struct reversi_game *g, int col, int row)
+{ 	/* initializes local variables */
+	int sq = 8 * row + col; /* location of the move converted to a single int*/
+	u64 flips; /* pieces the move would flip, none means an illegal move */
+	u64 start = TRACE_START(reversi_place_move_exit);
+	int status;
+
+	trace_reversi_place_move_enter(g->id, col, row);
+	if(g->userMove != false) /* if it is the user's turn */
+	{
+		/* checks if the move is valid, taken squares flip nothing */
+		flips = valid_move(g, sq, g->userPiece);
+		if(flips != 0) /* if a valid move */
+		{
+			/* sets the piece and flips the sandwiched ones */
+			flip_pieces(g, sq, g->userPiece, flips);
+			g->userMove = false; /* changes to CPU move */
+			/* OK unless someone has won */
+			status = check_winner(g);
+		}
+		else /* if location was not valid */
+		{
+			status = REVERSI_ILLMOVE;
+		}
+	}
+	else /* if it is not the user's turn */
+	{
+		status = REVERSI_OOT;
+	}
+	trace_reversi_place_move_exit(g->id, col, row, status, start);
+	return status;
+}
+
+
+static u64 valid_move(struct reversi_game *g, int sq, char piece)
+{	/* returns the pieces piece would flip by playing sq, 0 if illegal */
+	u64 start = ktime_get_ns();
+	u64 flips = 0;
+	/* anything not in the cached moves is illegal without looking */
+	if(g->moves[PIECE_IDX(piece)] & (1ULL << sq))
+	{
+		flips = bb_flips(g->disc[PIECE_IDX(piece)], g->disc[!PIECE_IDX(piece)], sq);
+	}
+	stat_time(HIST_VALID_MOVE, ktime_get_ns() - start);
+	return flips;
+}
+
+
+static int cpu_move(struct reversi_session *s, struct reversi_game *g)
+{	/* hands the search to the workqueue, cpu_work answers s when done */
+	/* if it's not the user's move and no other file asked already */
+	if(g->userMove == false && g->searching == false)
+	{
+		g->searching = true;
+		s->searching = true;
+		queue_work(reversiWq, &s->cpuWork);
+		return REVERSI_OK;
+	}
+	else /* if not the CPU's turn */
+	{
+		return REVERSI_OOT;
+	}
+}
+
+
+static void cpu_work(struct work_struct *work)
+{
+	struct reversi_session *s = container_of(work, struct reversi_session, cpuWork);
+	struct reversi_game *g = session_game(s);
+	struct cpu_result res;
+	int n = 0;
+
+	if(s->analyzeDepth != 0)
+	{
+		n = cpu_analyze(g, s->analyzeDepth, s->scores);
+	}
+	else
+	{
+		cpu_search(g, &res, false);
+	}
+	mutex_lock(&s->lock);
+	game_lock(g);
+	if(s->analyzeDepth != 0) /* an '08' only looks, the game is unchanged */
+	{
+		respond_analysis(s, s->scores, n);
+		s->analyzeDepth = 0;
+	}
+	else
+	{
+		respond(s, cpu_play(g, &res));
+	}
+	g->searching = false;
+	game_unlock(g);
+	s->searching = false;
+	/* carries on with whatever was queued behind the '03' */
+	run_commands(s);
+	mutex_unlock(&s->lock);
+	wake_up_interruptible(&s->wq);
+}
+
+
+static void cpu_search(struct reversi_game *g, struct cpu_result *res, bool locked)
+{	/* initializes local variables */
+	struct search_ctx ctx = { 0 };
+	int empties, depth, color;
+	u64 own, opp, hash, start;
+
+	/* the caller either set searching or has the game locked already, so
+	   nothing changes the game under this */
+	if(!locked)
+	{
+		down_read(&g->lock);
+	}
+	own = g->disc[PIECE_IDX(g->comPiece)];
+	opp = g->disc[PIECE_IDX(g->userPiece)];
+	hash = g->hash;
+	color = PIECE_IDX(g->comPiece);
+	depth = g->depth;
+	if(!locked)
+	{
+		up_read(&g->lock);
+	}
+
+	/* the search itself runs without holding the lock */
+	empties = 64 - hweight64(own | opp);
+	trace_reversi_cpu_move_enter(g->id, depth, empties);
+	start = ktime_get_ns();
+	res->solved = empties <= clamp(endgame_empties, 0, ENDGAME_MAX_EMPTIES);
+	if(res->solved) /* close enough to the end to play perfectly */
+	{
+		res->score = solve_root(&ctx, own, opp, &res->sq);
+	}
+	else
+	{
+		/* entries from earlier searches are the first to be replaced */
+		ctx.ttGen = engine_new_search();
+		res->score = search_root(&ctx, own, opp, hash, color, depth, &res->sq);
+	}
+	res->ns = ktime_get_ns() - start;
+	stat_time(HIST_CPU_MOVE, res->ns);
+	res->nodes = ctx.nodes;
+	atomic64_add(ctx.ttProbes, &ttProbes);
+	atomic64_add(ctx.ttHits, &ttHits);
+	atomic64_add(ctx.ttStores, &ttStores);
+}
+
+
+static int cpu_analyze(struct reversi_game *g, int depth, struct move_score *scores)
+{	/* the search behind '08', every move for the side to move scored
+	   from its point of view. Solved positions are scored like a won or
+	   lost search, disc difference times SCORE_DISC */
+	struct search_ctx ctx = { 0 };
+	int i, n, color;
+	bool solve;
+	u64 own, opp, hash;
+
+	down_read(&g->lock);
+	color = PIECE_IDX(game_to_move(g));
+	own = g->disc[color];
+	opp = g->disc[!color];
+	hash = g->hash;
+	up_read(&g->lock);
+
+	solve = 64 - hweight64(own | opp) <= clamp(endgame_empties, 0, ENDGAME_MAX_EMPTIES);
+	ctx.ttGen = engine_new_search();
+	n = analyze_root(&ctx, own, opp, hash, color, depth, solve, scores);
+	for(i = 0; solve && i < n; i++)
+	{
+		scores[i].score *= SCORE_DISC;
+	}
+	atomic64_add(ctx.ttProbes, &ttProbes);
+	atomic64_add(ctx.ttHits, &ttHits);
+	atomic64_add(ctx.ttStores, &ttStores);
+	return n;
+}
+
+
+static int cpu_play(struct reversi_game *g, const struct cpu_result *res)
+{	/* makes the move cpu_search picked, called with the game locked */
+	int status = REVERSI_OK;
+	/* sets it to user's move */
+	g->userMove = true;
+	if(res->sq >= 0) /* if there was a valid move */
+	{	/* sets piece and flips pieces */
+		flip_pieces(g, res->sq, g->comPiece, valid_move(g, res->sq, g->comPiece));
+		/* OK unless someone has won */
+		status = check_winner(g);
+	}
+	else
+	{
+		/* fixes issue where if CPU had no move it would lock up */
+		g->hash ^= zobristSide;
+		g->moveNumber++;
+		publish_board(g, REVERSI_OK);
+	}
+	trace_reversi_cpu_move_exit(g->id, res->sq >= 0 ? res->sq % 8 : -1,
+				    res->sq >= 0 ? res->sq / 8 : -1, res->nodes,
+				    res->ns, res->score, res->solved, status);
+	return status;
+}
+
+
+static void auto_reply(struct reversi_session *s, struct reversi_game *g, int status)
+{	/* answers a '00', '02' or '04' with status, unless it left the CPU to
+	   move in an 'A' game. Then the one response has how the game stands
+	   after cpu_reply and where the CPU went */
+	struct reversi_resp r = { .code = STAT_RESP_REPLY };
+	int sq;
+	if(!cpu_reply(g, &status, &sq))
+	{
+		respond(s, status);
+		return;
+	}
+	r.status = status;
+	r.sq = sq;
+	respond_resp(s, &r);
+}
+
+
+static bool cpu_reply(struct reversi_game *g, int *status, int *sq)
+{	/* in an 'A' game, a move that went through and left the CPU to move
+	   gets the CPU's move right away, searching with the game still
+	   locked. status becomes how the game stands after that and sq where
+	   the CPU went, -1 for a pass. The caller waits for the search, so
+	   deep searches are better off with plain '03'. False, with nothing
+	   changed, when the CPU does not answer */
+	struct cpu_result res;
+	if(*status != REVERSI_OK || !g->autoReply || g->userMove)
+	{
+		return false;
+	}
+	cpu_search(g, &res, true);
+	*status = cpu_play(g, &res);
+	*sq = res.sq;
+	return true;
+}
+
+
+static void flip_pieces(struct reversi_game *g, int sq, char piece, u64 flips)
+{	/* places piece on sq and turns over everything in flips */
+	int me = PIECE_IDX(piece), n = hweight64(flips);
+	g->disc[me] |= flips | (1ULL << sq);
+	g->disc[!me] &= ~flips;
+	g->count[me] += n + 1;
+	g->count[!me] -= n;
+	/* a move can open or close squares anywhere on the board, but the
+	   shifts in bb_moves are cheaper than working out which */
+	g->moves[me] = bb_moves(g->disc[me], g->disc[!me]);
+	g->moves[!me] = bb_moves(g->disc[!me], g->disc[me]);
+	g->moveNumber++;
+	/* every move hands the turn over, zobrist_move accounts for that */
+	g->hash = zobrist_move(g->hash, PIECE_IDX(piece), sq, flips);
+}
+
+static int user_pass(struct reversi_game *g)
+{
+	u64 start = TRACE_START(reversi_user_pass_exit);
+	int status;
+
+	trace_reversi_user_pass_enter(g->id);
+	if(g->userMove == true) /* if it in fact is the user's turn */
+	{
+		/* passing is only allowed with no legal move at all */
+		if(g->moves[PIECE_IDX(g->userPiece)] != 0)
+		{
+			status = REVERSI_ILLMOVE;
+		}
+		else /* if no valid user moves found*/
+		{
+			g->userMove = false; /* sets CPU's turn */
+			g->hash ^= zobristSide;
+			g->moveNumber++;
+			/* OK unless someone has won */
+			status = check_winner(g);
+		}
+	}
+	else /* if it is not the user's turn */
+	{
+		status = REVERSI_OOT;
+	}
+	trace_reversi_user_pass_exit(g->id, status, start);
+	return status;
+}
+
+
+static int check_winner(struct reversi_game *g)
+{	/* local variables to hold how many pieces each player has */
+	int userCount, cpuCount, status = REVERSI_OK;
+	u64 start = TRACE_START(reversi_check_winner_exit);
+	trace_reversi_check_winner_enter(g->id);
+	/* the game is over once neither player has a legal move left */
+	if(g->moves[0] == 0 && g->moves[1] == 0)
+	{
+		userCount = g->count[PIECE_IDX(g->userPiece)];
+		cpuCount = g->count[PIECE_IDX(g->comPiece)];
+		if(userCount > cpuCount) /* if user won */
+		{
+			status = REVERSI_WIN;
+		}
+		else if (cpuCount > userCount)/* if CPU won */
+		{
+			status = REVERSI_LOSE;
+		}
+		else /* if a tie */
+		{
+			status = REVERSI_TIE;
+		}
+		g->status = status; /* sets no game in progress */
+		trace_reversi_game_end(g->id, status, userCount, cpuCount, g->moveNumber);
+	}
+	/* every move and pass ends up here, so the page is always current */
+	publish_board(g, status);
+	trace_reversi_check_winner_exit(g->id, status, start);
+	return status; /* OK if there is no winner yet */
+}
+
+
+static void publish_board(struct reversi_game *g, int status)
+{	/* copies the game into pub and the mmap page, the lock is held for
+	   writing */
+	struct reversi_shared *s = g->shared;
+	u32 seq, toMove, userPiece;
+
+	toMove = PIECE_IDX(g->userMove ? g->userPiece : g->comPiece);
+	userPiece = PIECE_IDX(g->userPiece);
+	if(g->userPiece == 0) /* no game yet, X is up first */
+	{
+		toMove = PIECE_IDX(X);
+		userPiece = PIECE_IDX(X);
+	}
+	write_seqlock(&g->pubLock);
+	g->pub.x = g->disc[PIECE_IDX(X)];
+	g->pub.o = g->disc[PIECE_IDX(O)];
+	g->pub.toMove = toMove;
+	g->pub.userPiece = userPiece;
+	g->pub.inGame = status == REVERSI_OK;
+	write_sequnlock(&g->pubLock);
+
+	if(s == NULL) /* nobody has mapped it yet */
+	{
+		return;
+	}
+	seq = s->seq;
+	WRITE_ONCE(s->seq, seq + 1); /* odd, readers wait or retry */
+	smp_wmb();
+	s->moveNumber = g->moveNumber;
+	s->x = g->disc[PIECE_IDX(X)];
+	s->o = g->disc[PIECE_IDX(O)];
+	s->toMove = toMove;
+	s->userPiece = userPiece;
+	s->status = status;
+	smp_wmb();
+	WRITE_ONCE(s->seq, seq + 2);
+}
+
+
+static void set_board(struct reversi_game *g, u64 x, u64 o)
+{	/* puts a whole new board in the game, flip_pieces keeps it up to
+	   date from there */
+	g->disc[PIECE_IDX(X)] = x;
+	g->disc[PIECE_IDX(O)] = o;
+	g->moves[PIECE_IDX(X)] = bb_moves(x, o);
+	g->moves[PIECE_IDX(O)] = bb_moves(o, x);
+	g->count[PIECE_IDX(X)] = hweight64(x);
+	g->count[PIECE_IDX(O)] = hweight64(o);
+}
+
+
+static char game_to_move(struct reversi_game *g)
+{	/* X always moves first, before a game exists that is who is up */
+	if(g->userPiece == 0)
+	{
+		return X;
+	}
+	return g->userMove ? g->userPiece : g->comPiece;
+}
+
+
+static void render_board(u64 x, u64 o, char toMove, char *out)
+{	/* builds the 67 byte text board, 64 squares then tab, turn, newline */
+	int sq;
+	for(sq = 0; sq < 64; sq++)
+	{
+		if(x & (1ULL << sq))
+		{
+			out[sq] = X;
+		}
+		else if(o & (1ULL << sq))
+		{
+			out[sq] = O;
+		}
+		else
+		{
+			out[sq] = '-';
+		}
+	}
+	out[64] = '\t';
+	out[65] = toMove;
+	out[66] = '\n';
+}
+
+static int tt_stats_get(char *buffer, const struct kernel_param *kp)
+{
+	return sprintf(buffer, "probes %lld hits %lld stores %lld\n",
+		       (long long)atomic64_read(&ttProbes),
+		       (long long)atomic64_read(&ttHits),
+		       (long long)atomic64_read(&ttStores));
+}
+
+static void game_lock(struct reversi_game *g)
+{	/* down_write on the game, timing the wait and the hold */
+	u64 start = ktime_get_ns();
+	down_write(&g->lock);
+	g->lockedAt = ktime_get_ns();
+	stat_time(HIST_LOCK_WAIT, g->lockedAt - start);
+}
+
+
+static bool game_trylock(struct reversi_game *g)
+{	/* game_lock for callers that would rather not wait at all */
+	if(!down_write_trylock(&g->lock))
+	{
+		return false;
+	}
+	g->lockedAt = ktime_get_ns();
+	stat_time(HIST_LOCK_WAIT, 0);
+	return true;
+}
+
+
+static void game_unlock(struct reversi_game *g)
+{
+	stat_time(HIST_LOCK_HOLD, ktime_get_ns() - g->lockedAt);
+	up_write(&g->lock);
+}
+
+
+static void stat_time(int hist, u64 ns)
+{	/* counts ns in its log2 bucket of hist */
+	int bucket = ns != 0 ? ilog2(ns) : 0;
+	this_cpu_inc(reversiStats.hist[hist][min(bucket, HIST_BUCKETS - 1)]);
+}
+
+
+static int stats_commands_show(struct seq_file *m, void *v)
+{	/* debugfs commands, how many of each command has run */
+	u64 sum;
+	int i, cpu;
+	for(i = 0; i <= STAT_CMD_OTHER; i++)
+	{
+		sum = 0;
+		for_each_possible_cpu(cpu)
+		{
+			sum += per_cpu(reversiStats.cmds[i], cpu);
+		}
+		if(i < STAT_CMD_OTHER)
+		{
+			seq_printf(m, "0%d\t%llu\n", i, sum);
+		}
+		else
+		{
+			seq_printf(m, "other\t%llu\n", sum);
+		}
+	}
+	return 0;
+}
+
+
+static int stats_responses_show(struct seq_file *m, void *v)
+{	/* debugfs responses, how many of each response was sent */
+	u64 sum;
+	int i, cpu;
+	for(i = 0; i < STAT_RESP_COUNT; i++)
+	{
+		sum = 0;
+		for_each_possible_cpu(cpu)
+		{
+			sum += per_cpu(reversiStats.resps[i], cpu);
+		}
+		/* respText minus its newline */
+		if(i < STAT_RESP_BOARD)
+		{
+			seq_printf(m, "%.*s\t%llu\n", (int)strlen(respText[i]) - 1,
+				   respText[i], sum);
+		}
+		else
+		{
+			seq_printf(m, "%s\t%llu\n", respNames[i - STAT_RESP_BOARD], sum);
+		}
+	}
+	return 0;
+}
+
+
+static int stats_histograms_show(struct seq_file *m, void *v)
+{	/* debugfs histograms, one line per bucket that has anything in it */
+	u64 sum;
+	int h, i, cpu;
+	for(h = 0; h < HIST_COUNT; h++)
+	{
+		seq_printf(m, "%s\n", histNames[h]);
+		for(i = 0; i < HIST_BUCKETS; i++)
+		{
+			sum = 0;
+			for_each_possible_cpu(cpu)
+			{
+				sum += per_cpu(reversiStats.hist[h][i], cpu);
+			}
+			if(sum != 0)
+			{
+				seq_printf(m, "  >= %llu ns\t%llu\n", 1ULL << i, sum);
+			}
+		}
+	}
+	return 0;
+}
+
+static int stats_games_show(struct seq_file *m, void *v)
+{	/* debugfs games, what games are using and what was evicted */
+	struct game_shard *sh;
+	long long idle = 0, cap = 0;
+	unsigned int cpu;
+	int table = 0;
+	for_each_possible_cpu(cpu)
+	{
+		sh = per_cpu_ptr(&gameShards, cpu);
+		table += atomic_read(&sh->table.nelems);
+		idle += atomic64_read(&sh->evictIdle);
+		cap += atomic64_read(&sh->evictCap);
+	}
+	seq_printf(m, "games\t%lld\n", percpu_counter_sum(&liveGames));
+	seq_printf(m, "table\t%d\n", table);
+	seq_printf(m, "bytes\t%lld\n", percpu_counter_sum(&liveBytes));
+	seq_printf(m, "evicted_idle\t%lld\n", idle);
+	seq_printf(m, "evicted_cap\t%lld\n", cap);
+	/* then how the table games are spread, for shards that made any */
+	for_each_possible_cpu(cpu)
+	{
+		sh = per_cpu_ptr(&gameShards, cpu);
+		if(atomic64_read(&sh->ids) != 0)
+		{
+			seq_printf(m, "shard%u\t%d\t%lld\t%lld\n", cpu,
+				   atomic_read(&sh->table.nelems),
+				   (long long)atomic64_read(&sh->evictIdle),
+				   (long long)atomic64_read(&sh->evictCap));
+		}
+	}
+	return 0;
+}
+
+module_init(reversi_init);
+module_exit(reversi_exit);
@@ -0,0 +1,206 @@
+/* Tracepoints for the move pipeline, see them with
+   trace-cmd record -e reversi or perf record -e 'reversi:*'.
+   game is the id every open file's game gets, durations are in ns */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM reversi
+
+#if !defined(_REVERSI_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _REVERSI_TRACE_H
+
+#include <linux/tracepoint.h>
+#include <linux/ktime.h>
+
+/* Bytes of a command kept in the trace, same as CMD_MAX, which
+   reversi_main.c checks */
+#define REVERSI_TRACE_CMD	24
+
+/* A queued command about to run */
+TRACE_EVENT(reversi_dispatch,
+	TP_PROTO(u64 game, const char *cmd, unsigned int len),
+	TP_ARGS(game, cmd, len),
+	TP_STRUCT__entry(
+		__field(u64, game)
+		__array(char, cmd, REVERSI_TRACE_CMD)
+		__field(unsigned int, len)
+	),
+	TP_fast_assign(
+		__entry->game = game;
+		memset(__entry->cmd, 0, REVERSI_TRACE_CMD);
+		/* without the newline, it only gets in the way */
+		memcpy(__entry->cmd, cmd, min_t(unsigned int, len, REVERSI_TRACE_CMD));
+		strreplace(__entry->cmd, '\n', '\0');
+		__entry->len = len;
+	),
+	TP_printk("game=%llu cmd=\"%.*s\" len=%u", __entry->game,
+		  REVERSI_TRACE_CMD, __entry->cmd, __entry->len)
+);
+
+DECLARE_EVENT_CLASS(reversi_enter,
+	TP_PROTO(u64 game),
+	TP_ARGS(game),
+	TP_STRUCT__entry(
+		__field(u64, game)
+	),
+	TP_fast_assign(
+		__entry->game = game;
+	),
+	TP_printk("game=%llu", __entry->game)
+);
+
+/* start is 0 when the exit event was off at entry, see TRACE_START */
+DECLARE_EVENT_CLASS(reversi_exit,
+	TP_PROTO(u64 game, int status, u64 start),
+	TP_ARGS(game, status, start),
+	TP_STRUCT__entry(
+		__field(u64, game)
+		__field(int, status)
+		__field(u64, ns)
+	),
+	TP_fast_assign(
+		__entry->game = game;
+		__entry->status = status;
+		__entry->ns = start ? ktime_get_ns() - start : 0;
+	),
+	TP_printk("game=%llu status=%d ns=%llu", __entry->game,
+		  __entry->status, __entry->ns)
+);
+
+DEFINE_EVENT(reversi_enter, reversi_user_pass_enter,
+	TP_PROTO(u64 game),
+	TP_ARGS(game)
+);
+
+DEFINE_EVENT(reversi_exit, reversi_user_pass_exit,
+	TP_PROTO(u64 game, int status, u64 start),
+	TP_ARGS(game, status, start)
+);
+
+DEFINE_EVENT(reversi_enter, reversi_check_winner_enter,
+	TP_PROTO(u64 game),
+	TP_ARGS(game)
+);
+
+DEFINE_EVENT(reversi_exit, reversi_check_winner_exit,
+	TP_PROTO(u64 game, int status, u64 start),
+	TP_ARGS(game, status, start)
+);
+
+TRACE_EVENT(reversi_place_move_enter,
+	TP_PROTO(u64 game, int col, int row),
+	TP_ARGS(game, col, row),
+	TP_STRUCT__entry(
+		__field(u64, game)
+		__field(int, col)
+		__field(int, row)
+	),
+	TP_fast_assign(
+		__entry->game = game;
+		__entry->col = col;
+		__entry->row = row;
+	),
+	TP_printk("game=%llu col=%d row=%d", __entry->game, __entry->col,
+		  __entry->row)
+);
+
+TRACE_EVENT(reversi_place_move_exit,
+	TP_PROTO(u64 game, int col, int row, int status, u64 start),
+	TP_ARGS(game, col, row, status, start),
+	TP_STRUCT__entry(
+		__field(u64, game)
+		__field(int, col)
+		__field(int, row)
+		__field(int, status)
+		__field(u64, ns)
+	),
+	TP_fast_assign(
+		__entry->game = game;
+		__entry->col = col;
+		__entry->row = row;
+		__entry->status = status;
+		__entry->ns = start ? ktime_get_ns() - start : 0;
+	),
+	TP_printk("game=%llu col=%d row=%d status=%d ns=%llu", __entry->game,
+		  __entry->col, __entry->row, __entry->status, __entry->ns)
+);
+
+/* The CPU search starting, depth is ignored when solving the endgame */
+TRACE_EVENT(reversi_cpu_move_enter,
+	TP_PROTO(u64 game, int depth, int empties),
+	TP_ARGS(game, depth, empties),
+	TP_STRUCT__entry(
+		__field(u64, game)
+		__field(int, depth)
+		__field(int, empties)
+	),
+	TP_fast_assign(
+		__entry->game = game;
+		__entry->depth = depth;
+		__entry->empties = empties;
+	),
+	TP_printk("game=%llu depth=%d empties=%d", __entry->game,
+		  __entry->depth, __entry->empties)
+);
+
+/* The CPU's move made, col and row are -1 for a pass and ns is the
+   search alone */
+TRACE_EVENT(reversi_cpu_move_exit,
+	TP_PROTO(u64 game, int col, int row, u64 nodes, u64 ns, int score,
+		 bool solved, int status),
+	TP_ARGS(game, col, row, nodes, ns, score, solved, status),
+	TP_STRUCT__entry(
+		__field(u64, game)
+		__field(int, col)
+		__field(int, row)
+		__field(u64, nodes)
+		__field(u64, ns)
+		__field(int, score)
+		__field(bool, solved)
+		__field(int, status)
+	),
+	TP_fast_assign(
+		__entry->game = game;
+		__entry->col = col;
+		__entry->row = row;
+		__entry->nodes = nodes;
+		__entry->ns = ns;
+		__entry->score = score;
+		__entry->solved = solved;
+		__entry->status = status;
+	),
+	TP_printk("game=%llu col=%d row=%d nodes=%llu ns=%llu score=%d%s status=%d",
+		  __entry->game, __entry->col, __entry->row, __entry->nodes,
+		  __entry->ns, __entry->score, __entry->solved ? " solved" : "",
+		  __entry->status)
+);
+
+/* status is REVERSI_WIN, LOSE or TIE from the user's side */
+TRACE_EVENT(reversi_game_end,
+	TP_PROTO(u64 game, int status, int userDiscs, int cpuDiscs, int moves),
+	TP_ARGS(game, status, userDiscs, cpuDiscs, moves),
+	TP_STRUCT__entry(
+		__field(u64, game)
+		__field(int, status)
+		__field(int, userDiscs)
+		__field(int, cpuDiscs)
+		__field(int, moves)
+	),
+	TP_fast_assign(
+		__entry->game = game;
+		__entry->status = status;
+		__entry->userDiscs = userDiscs;
+		__entry->cpuDiscs = cpuDiscs;
+		__entry->moves = moves;
+	),
+	TP_printk("game=%llu status=%d user=%d cpu=%d moves=%d", __entry->game,
+		  __entry->status, __entry->userDiscs, __entry->cpuDiscs,
+		  __entry->moves)
+);
+
+#endif /* _REVERSI_TRACE_H */
+
+/* This part must be outside protection */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE reversi_trace
+#include <trace/define_trace.h>
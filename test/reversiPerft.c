@@ -0,0 +1,448 @@
+/*
+    reversiPerft.c -- Userspace correctness and speed checks for the engine.
+
+    Builds against module/reversi_engine.c through reversi_compat.h, so
+    this runs the exact code the module does without loading anything.
+
+    Usage: reversiPerft [-d depth] [-c] [-b]
+        -d  perft from the start position to depth (default 9)
+        -c  check mode: perft against the reference counts, the endgame
+            solver and analyze_root's move scores against a plain
+            minimax or fixed depth negamax, exits non-zero on a mismatch
+        -b  microbenchmarks of move generation, the search and the solver
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "reversi_engine.h"
+
+#define PERFT_MAX   14
+/* Depth check_analyze asks analyze_root for */
+#define ANALYZE_DEPTH   4
+
+/* Leaf counts from the start position, a pass counts as a ply and a
+   finished game is a leaf however deep it is */
+static const unsigned long long perftRef[PERFT_MAX + 1] = {
+    1ULL, 4ULL, 12ULL, 56ULL, 244ULL, 1396ULL, 8200ULL, 55092ULL, 390216ULL,
+    3005288ULL, 24571284ULL, 212258800ULL, 1939886636ULL, 18429641748ULL,
+    184042084508ULL
+};
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned long long perft(u64 own, u64 opp, int depth, int passed) {
+    unsigned long long n = 0;
+    u64 moves, flips;
+    int sq;
+
+    if(depth == 0)
+        return 1;
+
+    moves = bb_moves(own, opp);
+
+    if(!moves) {
+        if(passed)
+            return 1;
+
+        return perft(opp, own, depth - 1, 1);
+    }
+
+    /* Counting the last ply needs no flips at all */
+    if(depth == 1)
+        return __builtin_popcountll(moves);
+
+    while(moves) {
+        sq = __builtin_ctzll(moves);
+        moves &= moves - 1;
+        flips = bb_flips(own, opp, sq);
+        n += perft(opp & ~flips, own | flips | (1ULL << sq), depth - 1, 0);
+    }
+
+    return n;
+}
+
+static int run_perft(int maxDepth) {
+    unsigned long long n;
+    double start, t;
+    int d, bad = 0;
+
+    printf("%-6s %16s %16s %10s %14s\n", "depth", "leaves", "reference",
+           "seconds", "leaves/s");
+
+    for(d = 1; d <= maxDepth; ++d) {
+        start = now();
+        n = perft(BB_START_X, BB_START_O, d, 0);
+        t = now() - start;
+
+        if(d <= PERFT_MAX && n != perftRef[d])
+            ++bad;
+
+        printf("%-6d %16llu %16llu %10.3f %14.0f%s\n", d, n,
+               d <= PERFT_MAX ? perftRef[d] : 0ULL, t, t > 0 ? n / t : 0.0,
+               d <= PERFT_MAX && n != perftRef[d] ? "  MISMATCH" : "");
+    }
+
+    return bad;
+}
+
+/* Plain minimax to the end of the game, the disc difference for own with
+   empties going to the winner, to hold solve_root to */
+static int minimax(u64 own, u64 opp, int passed) {
+    u64 moves = bb_moves(own, opp), flips;
+    int sq, score, best = -65, diff, empties;
+
+    if(!moves) {
+        if(!passed)
+            return -minimax(opp, own, 1);
+
+        diff = __builtin_popcountll(own) - __builtin_popcountll(opp);
+        empties = 64 - __builtin_popcountll(own | opp);
+        return diff > 0 ? diff + empties : (diff < 0 ? diff - empties : 0);
+    }
+
+    while(moves) {
+        sq = __builtin_ctzll(moves);
+        moves &= moves - 1;
+        flips = bb_flips(own, opp, sq);
+        score = -minimax(opp & ~flips, own | flips | (1ULL << sq), 0);
+
+        if(score > best)
+            best = score;
+    }
+
+    return best;
+}
+
+/* The engine's evaluation written out again, the group masks and
+   weights have to match moveOrder and orderWeight in reversi_engine.c */
+static int ref_evaluate(u64 own, u64 opp) {
+    static const u64 groups[5] = {
+        BB_CORNERS,
+        BB_EDGES & ~BB_CORNERS & ~BB_C_SQUARES,
+        ~BB_EDGES & ~BB_X_SQUARES,
+        BB_C_SQUARES,
+        BB_X_SQUARES,
+    };
+    static const int weights[5] = { 20, 4, 1, -4, -8 };
+    int i, score = 0;
+
+    for(i = 0; i < 5; ++i)
+        score += weights[i] * (__builtin_popcountll(own & groups[i]) -
+                               __builtin_popcountll(opp & groups[i]));
+
+    return score + 3 * (__builtin_popcountll(bb_moves(own, opp)) -
+                        __builtin_popcountll(bb_moves(opp, own)));
+}
+
+/* Fixed depth negamax with no pruning or table, to hold analyze_root's
+   unsolved scores to. Passes cost no depth and a finished game is worth
+   its disc difference times SCORE_DISC, as in search_node */
+static int negamax(u64 own, u64 opp, int depth, int passed) {
+    u64 moves, flips;
+    int sq, score, best = -SCORE_INF;
+
+    if(depth == 0)
+        return ref_evaluate(own, opp);
+
+    moves = bb_moves(own, opp);
+
+    if(!moves) {
+        if(passed)
+            return SCORE_DISC * (__builtin_popcountll(own) -
+                                 __builtin_popcountll(opp));
+
+        return -negamax(opp, own, depth, 1);
+    }
+
+    while(moves) {
+        sq = __builtin_ctzll(moves);
+        moves &= moves - 1;
+        flips = bb_flips(own, opp, sq);
+        score = -negamax(opp & ~flips, own | flips | (1ULL << sq), depth - 1,
+                         0);
+
+        if(score > best)
+            best = score;
+    }
+
+    return best;
+}
+
+/* Plays random moves from the start until empties squares are left,
+   returns 0 if the game ended first */
+static int random_position(unsigned int *seed, int empties, u64 *own,
+                           u64 *opp) {
+    u64 moves, flips, t;
+    int sq, n, passes = 0;
+
+    *own = BB_START_X;
+    *opp = BB_START_O;
+
+    while(64 - __builtin_popcountll(*own | *opp) > empties) {
+        moves = bb_moves(*own, *opp);
+
+        if(moves) {
+            passes = 0;
+
+            for(n = rand_r(seed) % __builtin_popcountll(moves); n > 0; --n)
+                moves &= moves - 1;
+
+            sq = __builtin_ctzll(moves);
+            flips = bb_flips(*own, *opp, sq);
+            *own |= flips | (1ULL << sq);
+            *opp &= ~flips;
+        }
+        else if(++passes == 2) {
+            return 0;
+        }
+
+        t = *own;
+        *own = *opp;
+        *opp = t;
+    }
+
+    return 1;
+}
+
+static int check_solver(int positions, int empties) {
+    struct search_ctx ctx;
+    unsigned int seed = 421;
+    u64 own, opp, flips;
+    int i, bad = 0, score, best, bestSq, moveScore;
+
+    for(i = 0; i < positions;) {
+        if(!random_position(&seed, empties, &own, &opp))
+            continue;
+
+        memset(&ctx, 0, sizeof(ctx));
+        score = solve_root(&ctx, own, opp, &bestSq);
+        best = minimax(own, opp, 0);
+
+        /* The move it picked has to actually reach that score */
+        moveScore = best;
+
+        if(bestSq >= 0) {
+            flips = bb_flips(own, opp, bestSq);
+            moveScore = -minimax(opp & ~flips, own | flips | (1ULL << bestSq),
+                                 0);
+        }
+
+        if(score != best || moveScore != best) {
+            printf("solver mismatch at %d empties: %016llx %016llx solved "
+                   "%d, minimax %d, its move scores %d\n", empties, own, opp,
+                   score, best, moveScore);
+            ++bad;
+        }
+
+        ++i;
+    }
+
+    printf("endgame solver: %d positions at %d empties, %d mismatches\n",
+           positions, empties, bad);
+    return bad;
+}
+
+/* analyze_root has to list every legal move once, best first, each
+   scored with what that move leads to: minimax's result when solved and
+   negamax's to the same depth when not */
+static int check_analyze(int positions, int empties) {
+    struct search_ctx ctx;
+    struct move_score scores[64];
+    unsigned int seed = 4210;
+    u64 own, opp, flips, seen;
+    int i, j, n, solve, bad = 0, want;
+
+    for(i = 0; i < positions;) {
+        if(!random_position(&seed, empties, &own, &opp))
+            continue;
+
+        /* minimax takes forever much before the midgame */
+        for(solve = 0; solve <= (empties <= 12); ++solve) {
+            memset(&ctx, 0, sizeof(ctx));
+            n = analyze_root(&ctx, own, opp, zobrist_hash(own, opp, 0), 0,
+                             ANALYZE_DEPTH, solve, scores);
+            seen = 0;
+
+            for(j = 0; j < n; ++j) {
+                flips = bb_flips(own, opp, scores[j].sq);
+
+                if(solve)
+                    want = -minimax(opp & ~flips,
+                                    own | flips | (1ULL << scores[j].sq), 0);
+                else
+                    want = -negamax(opp & ~flips,
+                                    own | flips | (1ULL << scores[j].sq),
+                                    ANALYZE_DEPTH - 1, 0);
+
+                if(scores[j].score != want ||
+                   (j > 0 && scores[j].score > scores[j - 1].score)) {
+                    printf("analysis mismatch at %d empties: %016llx %016llx "
+                           "move %d scored %d, want %d%s\n", empties, own, opp,
+                           scores[j].sq, scores[j].score, want,
+                           solve ? " solved" : "");
+                    ++bad;
+                }
+
+                seen |= 1ULL << scores[j].sq;
+            }
+
+            if(seen != bb_moves(own, opp) ||
+               n != __builtin_popcountll(seen)) {
+                printf("analysis at %d empties: %016llx %016llx listed "
+                       "%016llx, moves are %016llx\n", empties, own, opp,
+                       seen, bb_moves(own, opp));
+                ++bad;
+            }
+        }
+
+        ++i;
+    }
+
+    printf("move analysis: %d positions at %d empties, %d mismatches\n",
+           positions, empties, bad);
+    return bad;
+}
+
+static void bench(void) {
+    struct search_ctx ctx;
+    unsigned int seed = 421;
+    u64 own, opp, sink = 0, moves;
+    long i, n;
+    int sq, depth, empties, bestSq;
+    double start, t;
+
+    /* Move generation on a spread of midgame positions */
+    for(n = 0, i = 0; i < 200; ) {
+        if(random_position(&seed, 30, &own, &opp))
+            ++i;
+    }
+
+    start = now();
+
+    for(i = 0; i < 5000000; ++i) {
+        sink += bb_moves(own ^ (i & 1), opp);
+        ++n;
+    }
+
+    t = now() - start;
+    printf("bb_moves:   %8.1f ns/call\n", t / n * 1e9);
+
+    moves = bb_moves(own, opp);
+    sq = moves ? __builtin_ctzll(moves) : 0;
+    start = now();
+
+    for(n = 0, i = 0; i < 5000000; ++i) {
+        sink += bb_flips(own, opp ^ (i & 1ULL << 63), sq);
+        ++n;
+    }
+
+    t = now() - start;
+    printf("bb_flips:   %8.1f ns/call\n", t / n * 1e9);
+
+    /* The midgame search, same random openings every run */
+    for(depth = 4; depth <= 8; depth += 2) {
+        seed = 421;
+        memset(&ctx, 0, sizeof(ctx));
+        start = now();
+
+        for(i = 0; i < 10; ) {
+            if(!random_position(&seed, 44, &own, &opp))
+                continue;
+
+            ctx.ttGen = engine_new_search();
+            search_root(&ctx, own, opp, zobrist_hash(own, opp, 0), 0, depth,
+                        &bestSq);
+            ++i;
+        }
+
+        t = now() - start;
+        printf("search d%-2d: %12llu nodes %8.3f s %12.0f nodes/s\n", depth,
+               ctx.nodes, t, ctx.nodes / t);
+    }
+
+    /* The endgame solver up to a little past the module's default */
+    for(empties = 10; empties <= 14; empties += 2) {
+        seed = 421;
+        memset(&ctx, 0, sizeof(ctx));
+        start = now();
+
+        for(i = 0; i < 10; ) {
+            if(!random_position(&seed, empties, &own, &opp))
+                continue;
+
+            solve_root(&ctx, own, opp, &bestSq);
+            ++i;
+        }
+
+        t = now() - start;
+        printf("solve %2de: %12llu nodes %8.3f s %12.0f nodes/s\n", empties,
+               ctx.nodes, t, ctx.nodes / t);
+    }
+
+    if(sink == 42)
+        printf("\n");
+}
+
+int main(int argc, char *argv[]) {
+    int opt, depth = 9, check = 0, doBench = 0, bad;
+
+    while((opt = getopt(argc, argv, "d:cb")) != -1) {
+        switch(opt) {
+            case 'd':
+                depth = atoi(optarg);
+                break;
+
+            case 'c':
+                check = 1;
+                break;
+
+            case 'b':
+                doBench = 1;
+                break;
+
+            default:
+                fprintf(stderr, "Usage: %s [-d depth] [-c] [-b]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    if(engine_init(16)) {
+        fprintf(stderr, "Cannot allocate the transposition table\n");
+        return EXIT_FAILURE;
+    }
+
+    if(doBench) {
+        bench();
+        engine_exit();
+        return EXIT_SUCCESS;
+    }
+
+    bad = run_perft(depth);
+
+    if(check) {
+        bad += check_solver(200, 10);
+        bad += check_analyze(100, 9);
+        bad += check_analyze(100, 30);
+    }
+
+    engine_exit();
+
+    if(bad) {
+        printf("FAILED\n");
+        return EXIT_FAILURE;
+    }
+
+    if(check)
+        printf("OK\n");
+
+    return EXIT_SUCCESS;
+}